@@ -32,7 +32,11 @@ SOURCES += \
     program/globals.cpp \
     program/randomnumbers.cpp \
     program/stats.cpp \
+    program/statslog.cpp \
+    program/statslogfile.cpp \
+    program/blockgzip.cpp \
     program/saverandloader.cpp \
+    program/portablebinaryarchive.cpp \
     plant/genome.cpp \
     plant/organism.cpp \
     plant/plantpart.cpp \
@@ -40,6 +44,7 @@ SOURCES += \
     settings/simulationsettings.cpp \
     settings/environmentsettings.cpp \
     settings/environmentvalues.cpp \
+    settings/ticksettings.cpp \
     ui/infotextwidget.cpp \
     ui/mainwindow.cpp \
     ui/environmentwidget.cpp \
@@ -60,14 +65,19 @@ SOURCES += \
     ui/cloud.cpp \
     ui/recoverautosavefilesdialog.cpp \
     ui/myscrollarea.cpp \
-    ui/verticalscrollarea.cpp
+    ui/verticalscrollarea.cpp \
+    ui/historytimespinbox.cpp
 
 HEADERS  += \
     program/environment.h \
     program/globals.h \
     program/randomnumbers.h \
     program/stats.h \
+    program/statslog.h \
+    program/statslogfile.h \
+    program/blockgzip.h \
     program/saverandloader.h \
+    program/portablebinaryarchive.h \
     program/point2d.h \
     plant/genome.h \
     plant/organism.h \
@@ -79,6 +89,7 @@ HEADERS  += \
     settings/simulationsettings.h \
     settings/environmentsettings.h \
     settings/environmentvalues.h \
+    settings/ticksettings.h \
     ui/mainwindow.h \
     ui/infotextwidget.h \
     ui/environmentwidget.h \
@@ -99,7 +110,8 @@ HEADERS  += \
     ui/cloud.h \
     ui/recoverautosavefilesdialog.h \
     ui/myscrollarea.h \
-    ui/verticalscrollarea.h
+    ui/verticalscrollarea.h \
+    ui/historytimespinbox.h
 
 FORMS    += \
     ui/mainwindow.ui \
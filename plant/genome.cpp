@@ -21,56 +21,178 @@
 #include "../program/randomnumbers.h"
 #include "../settings/simulationsettings.h"
 #include "../settings/environmentsettings.h"
+#include "../settings/ticksettings.h"
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//Promoters up to this length are looked up in an index with a bucket for every
+//possible promoter.  Longer ones would need too many buckets (4 to the power of
+//the length), so they are searched for one position at a time.
+const int MAX_INDEXED_PROMOTER_LENGTH = 6;
+
+
+//Returns the number of set bits in a 64-bit word.
+static inline int popcount64(uint64_t x)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+    return int(__popcnt64(x));
+#elif defined(__GNUC__)
+    return __builtin_popcountll(x);
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return int((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+
+//Returns a mask covering the bits of the given word that hold nucleotides in the
+//range [start, end).
+static inline uint64_t getNucleotideRangeMask(int word, int start, int end)
+{
+    int wordStart = word * 32;
+    int first = std::max(start, wordStart) - wordStart;
+    int last = std::min(end, wordStart + 32) - wordStart;
+
+    uint64_t fromFirst = ~uint64_t(0) >> (2 * first);
+    uint64_t beforeLast = (last >= 32) ? ~uint64_t(0) : ~(~uint64_t(0) >> (2 * last));
+    return fromFirst & beforeLast;
+}
 
 
 
 //This constructor can either make a genome using the starting genome in settings or using
 //two parent genomes.
-Genome::Genome(bool startingGenome, boost::shared_ptr<Genome> parent1, boost::shared_ptr<Genome> parent2)
+Genome::Genome(bool startingGenome, boost::shared_ptr<Genome> parent1, boost::shared_ptr<Genome> parent2,
+               RandomNumbers * randomNumbers) :
+    m_length(0), m_promoterIndexLength(-1), m_compiledGenesPromoterLength(-1), m_compiledGenesMaxChildren(-1)
 {
-    m_nucleotides.reserve(g_simulationSettings->genomeLength);
+    int genomeLength = g_simulationSettings->genomeLength;
+    resize(genomeLength);
 
     if (startingGenome)
     {
-        int startingGenomeSize = int(g_simulationSettings->startingGenome.m_nucleotides.size());
-        for (int i = 0; i < g_simulationSettings->genomeLength; ++i)
-        {
-            if (i < startingGenomeSize)
-                m_nucleotides.push_back(g_simulationSettings->startingGenome.m_nucleotides[i]);
-            else
-                m_nucleotides.push_back(0);
-        }
+        copyNucleotides(&g_simulationSettings->startingGenome, 0, genomeLength);
         return;
     }
 
-    //Add one gene to the genome at a time, switching between the
-    //two based on the crossover frequency.
+    //Copy one fragment at a time into the genome, switching between the
+    //two parents based on the crossover frequency.
     Genome * sourceGenome = parent1.get();
     Genome * otherGenome = parent2.get();
-    if (g_randomNumbers->fiftyPercentChance())
+    if (randomNumbers->fiftyPercentChance())
         std::swap(sourceGenome, otherGenome);
 
     //Instead of calculating a random chance of crossover at each
     //nucleotide, an exponential distribution is used to achieve the
-    //same effect more efficiently.
-    int crossoverFragmentLength = g_randomNumbers->getCrossoverFragmentLength(g_simulationSettings->averageCrossoverLength);
-    for (int i = 0; i < g_simulationSettings->genomeLength; ++i)
+    //same effect more efficiently.  A fragment length of zero still
+    //takes one nucleotide from its parent before switching again.
+    int crossoverFragmentLength = randomNumbers->getCrossoverFragmentLength(g_simulationSettings->averageCrossoverLength);
+    int i = 0;
+    while (i < genomeLength)
     {
         if (crossoverFragmentLength <= 0)
         {
             std::swap(sourceGenome, otherGenome);
-            crossoverFragmentLength = g_randomNumbers->getCrossoverFragmentLength(g_simulationSettings->averageCrossoverLength);
+            crossoverFragmentLength = randomNumbers->getCrossoverFragmentLength(g_simulationSettings->averageCrossoverLength);
         }
 
-        if (i < int(sourceGenome->m_nucleotides.size()))
-            m_nucleotides.push_back(sourceGenome->m_nucleotides[i]);
-        else
-            m_nucleotides.push_back(0);
+        int fragmentEnd = std::min(i + std::max(crossoverFragmentLength, 1), genomeLength);
+        copyNucleotides(sourceGenome, i, fragmentEnd);
+        crossoverFragmentLength -= fragmentEnd - i;
+        i = fragmentEnd;
+    }
+
+    mutate(randomNumbers);
+}
+
 
-        --crossoverFragmentLength;
+//Only the nucleotides are copied.  The decoded data of this genome is dropped,
+//as it no longer matches.
+Genome & Genome::operator=(const Genome & other)
+{
+    if (this != &other)
+    {
+        clearDecodedData();
+        m_words = other.m_words;
+        m_length = other.m_length;
     }
+    return *this;
+}
+
+
+//Used whenever the nucleotides change.
+void Genome::clearDecodedData()
+{
+    clearPromoterIndex();
+    m_compiledGenes.clear();
+    m_compiledGenesPromoterLength = -1;
+    m_compiledGenesMaxChildren = -1;
+}
+
+
+void Genome::addNucleotide(char newNucleotide)
+{
+    clearDecodedData();
+    resize(m_length + 1);
+    setNucleotide(m_length - 1, newNucleotide);
+}
 
-    mutate();
+
+void Genome::setNucleotide(int index, char nucleotide)
+{
+    uint64_t & word = m_words[wordIndex(index)];
+    int shift = bitShift(index);
+    word = (word & ~(uint64_t(3) << shift)) | (uint64_t(nucleotide & 3) << shift);
+}
+
+
+void Genome::resize(int newLength)
+{
+    m_words.resize((newLength + 31) / 32, 0);
+    m_length = newLength;
+
+    //Keep the unused bits at the end of the last word as zero, as the
+    //word-level comparisons rely on it.
+    if (m_length % 32 != 0)
+        m_words.back() &= getNucleotideRangeMask(int(m_words.size()) - 1, 0, m_length);
+}
+
+
+//This function copies the nucleotides in the range [start, end) from the source
+//genome into this genome at the same positions.  Positions past the end of the
+//source genome are set to zero.  Whole words are copied with one memcpy and only
+//the words at the edges of the range need masking.
+void Genome::copyNucleotides(const Genome * source, int start, int end)
+{
+    if (start >= end)
+        return;
+
+    int copyEnd = std::min(end, source->m_length);
+    int fullWordsBegin = (start + 31) / 32;
+    int fullWordsEnd = std::max(std::min(end, copyEnd) / 32, fullWordsBegin);
+    if (fullWordsEnd > fullWordsBegin)
+        memcpy(&m_words[fullWordsBegin], &source->m_words[fullWordsBegin], (fullWordsEnd - fullWordsBegin) * sizeof(uint64_t));
+
+    for (int word = wordIndex(start); word < fullWordsBegin; ++word)
+        copyPartOfWord(source, word, start, end, copyEnd);
+    for (int word = fullWordsEnd; word <= wordIndex(end - 1); ++word)
+        copyPartOfWord(source, word, start, end, copyEnd);
+}
+
+void Genome::copyPartOfWord(const Genome * source, int word, int start, int end, int copyEnd)
+{
+    uint64_t mask = getNucleotideRangeMask(word, start, end);
+    uint64_t sourceWord = 0;
+    if (word * 32 < copyEnd)
+        sourceWord = source->m_words[word] & getNucleotideRangeMask(word, start, copyEnd);
+    m_words[word] = (m_words[word] & ~mask) | sourceWord;
 }
 
 
@@ -78,60 +200,144 @@ Genome::Genome(bool startingGenome, boost::shared_ptr<Genome> parent1, boost::sh
 //Instead of calculating a random chance for every nucleotide (would be intensive),
 //this code gets a number of mutations and then randomly distributes them around
 //the genome.
-void Genome::mutate()
+void Genome::mutate(RandomNumbers * randomNumbers)
 {
-    int genomeLength = int(m_nucleotides.size());
-    int mutationCount = g_randomNumbers->getMutationCount(genomeLength,
+    clearDecodedData();
+
+    int genomeLength = m_length;
+    int mutationCount = randomNumbers->getMutationCount(genomeLength,
                                                           g_environmentSettings->m_currentValues.m_mutationRate);
+    mutationCount = std::min(mutationCount, genomeLength);
 
+    //Choose the positions, then sort them and remove any duplicates.  Duplicates
+    //are replaced with new random positions until all are unique.  As with
+    //choosing unique positions one at a time, every set of positions is equally
+    //likely.
     std::vector<int> mutatedPositions;
     mutatedPositions.reserve(mutationCount);
-
-    for (int i = 0; i < mutationCount; ++i)
+    while (int(mutatedPositions.size()) < mutationCount)
     {
-        //Find a unique location for each mutation.
-        int mutationPosition;
-        do
-        {
-            mutationPosition = g_randomNumbers->getRandomInt(0, genomeLength - 1);
-        } while (std::find(mutatedPositions.begin(), mutatedPositions.end(), mutationPosition) != mutatedPositions.end());
-
-        mutatedPositions.push_back(mutationPosition);
-        changeOneNucleotide(mutationPosition);
+        for (int i = int(mutatedPositions.size()); i < mutationCount; ++i)
+            mutatedPositions.push_back(randomNumbers->getRandomInt(0, genomeLength - 1));
+        std::sort(mutatedPositions.begin(), mutatedPositions.end());
+        mutatedPositions.erase(std::unique(mutatedPositions.begin(), mutatedPositions.end()), mutatedPositions.end());
     }
-}
 
-void Genome::changeOneNucleotide(int index)
-{
-    char originalNucleotide = m_nucleotides[index];
-    char newNucleotide;
-    do
+    //XORing a nucleotide with a random value from 1 to 3 changes it to one of
+    //the other three nucleotides with equal chance.  The changes to each word are
+    //combined and applied at once.
+    std::vector<int>::const_iterator i = mutatedPositions.begin();
+    while (i != mutatedPositions.end())
     {
-        newNucleotide = g_randomNumbers->getRandomZeroToThree();
-    } while (originalNucleotide == newNucleotide);
-    m_nucleotides[index] = newNucleotide;
+        int word = wordIndex(*i);
+        uint64_t mutations = 0;
+        for (; i != mutatedPositions.end() && wordIndex(*i) == word; ++i)
+            mutations |= uint64_t(randomNumbers->getRandomOneToThree()) << bitShift(*i);
+        m_words[word] ^= mutations;
+    }
 }
 
 
-//This function returns a gene index using a given starting point and a two number promoter.
+
+//This function returns a gene index using a given starting point and the location of
+//a promoter reference in the genome.
 //The gene index returned is after the promoter (does not include the promoter).
-//FUTURE IMPROVEMENT: THIS USES A NAIVE STRING MATCHING ALGORITHM.  SOMETHING LIKE BOYER-MOORE COULD DO BETTER!
-int Genome::getIndexFromPromoter(int searchingIndex, std::vector<char> * promoter) const
+int Genome::getIndexFromPromoter(int searchingIndex, int promoterIndex, const TickSettings & settings) const
 {
     //The starting point for the search is after the current gene ends.
     //The ending point is right before the current gene's start.
     //This range means the whole genome will be searched except for the current gene,
     //so that gene's reference to the promoter won't be found as as a result.
-    int sizeOfBranchGene = 14 + g_simulationSettings->promoterLength * g_simulationSettings->maxChildrenPerBranch; //14 is the length of a branch gene, not including promoter references at the end.
-    int startingPoint = loopIndex(searchingIndex + sizeOfBranchGene);
+    int promoterLength = settings.promoterLength;
+    int startingPoint = loopIndex(searchingIndex + settings.getBranchGeneLength());
     int endingPoint = previousIndex(searchingIndex);
+    int searchRangeLength = (endingPoint - startingPoint + m_length) % m_length;
+
+    if (promoterLength < 1 || promoterLength > MAX_INDEXED_PROMOTER_LENGTH)
+        return findPromoter(startingPoint, endingPoint, promoterIndex, promoterLength);
+    if (m_promoterIndexLength != promoterLength)
+        buildPromoterIndex(promoterLength);
+
+    //The first occurrence of the promoter at or circularly after the starting
+    //point is the one the search would find first.  If it isn't before the
+    //ending point, there is no match in the range.
+    int promoter = getPromoterCode(promoterIndex, promoterLength);
+    std::vector<int>::const_iterator bucketBegin = m_promoterPositions.begin() + m_promoterBucketStarts[promoter];
+    std::vector<int>::const_iterator bucketEnd = m_promoterPositions.begin() + m_promoterBucketStarts[promoter + 1];
+    if (bucketBegin == bucketEnd)
+        return -1;
+
+    std::vector<int>::const_iterator match = std::lower_bound(bucketBegin, bucketEnd, startingPoint);
+    if (match == bucketEnd)
+        match = bucketBegin;
+    if ((*match - startingPoint + m_length) % m_length >= searchRangeLength)
+        return -1;
+
+    return *match + promoterLength;
+}
+
+
+//Reads the promoter starting at the given index as a base-4 number, wrapping
+//around the end of the genome if necessary.
+int Genome::getPromoterCode(int index, int promoterLength) const
+{
+    index = loopIndex(index);
+    if (index + promoterLength <= m_length)
+        return getNucleotidesAsNumber(index, promoterLength);
+
+    int promoter = 0;
+    for (int i = 0; i < promoterLength; ++i)
+        promoter = 4 * promoter + getNucleotide(index + i);
+    return promoter;
+}
+
+
+//Every position in the genome starts one (circular) promoter, so the index is
+//built with a counting sort of the positions by promoter.  Positions are added
+//in increasing order, so each bucket ends up sorted.
+//Each promoter's code is made from the previous one by shifting in the next
+//nucleotide.
+void Genome::buildPromoterIndex(int promoterLength) const
+{
+    int bucketCount = 1 << (2 * promoterLength);
+    int mask = bucketCount - 1;
+
+    std::vector<int> promoters(m_length);
+    if (m_length > 0)
+    {
+        int promoter = getPromoterCode(0, promoterLength);
+        promoters[0] = promoter;
+        for (int i = 1; i < m_length; ++i)
+        {
+            promoter = ((promoter << 2) | getNucleotide(i + promoterLength - 1)) & mask;
+            promoters[i] = promoter;
+        }
+    }
+
+    m_promoterBucketStarts.assign(bucketCount + 1, 0);
+    for (int i = 0; i < m_length; ++i)
+        ++m_promoterBucketStarts[promoters[i] + 1];
+    for (int i = 0; i < bucketCount; ++i)
+        m_promoterBucketStarts[i + 1] += m_promoterBucketStarts[i];
+
+    m_promoterPositions.resize(m_length);
+    std::vector<int> nextSlot(m_promoterBucketStarts.begin(), m_promoterBucketStarts.end() - 1);
+    for (int i = 0; i < m_length; ++i)
+        m_promoterPositions[nextSlot[promoters[i]]++] = i;
+
+    m_promoterIndexLength = promoterLength;
+}
 
+
+//Promoters too long to index are searched for one position at a time.
+int Genome::findPromoter(int startingPoint, int endingPoint, int promoterIndex, int promoterLength) const
+{
     for (int i = startingPoint; i != endingPoint; i = nextIndex(i))
     {
         bool matchFound = true;
-        for (int j = 0; j < g_simulationSettings->promoterLength; ++j)
+        for (int j = 0; j < promoterLength; ++j)
         {
-            if ( (*promoter)[j] != m_nucleotides[loopIndex(i+j)] )
+            if (getNucleotide(promoterIndex + j) != getNucleotide(i + j))
             {
                 matchFound = false;
                 break;
@@ -139,7 +345,7 @@ int Genome::getIndexFromPromoter(int searchingIndex, std::vector<char> * promote
         }
 
         if (matchFound)
-            return i + g_simulationSettings->promoterLength;
+            return i + promoterLength;
     }
 
     //Return -1 if no match was found.
@@ -148,13 +354,84 @@ int Genome::getIndexFromPromoter(int searchingIndex, std::vector<char> * promote
 
 
 
+//Returns the decoded gene at the given gene index, decoding it first if this
+//is the first time it has been used.
+const CompiledGene & Genome::getCompiledGene(int geneIndex, const TickSettings & settings) const
+{
+    if (m_compiledGenesPromoterLength != settings.promoterLength ||
+            m_compiledGenesMaxChildren != settings.maxChildrenPerBranch)
+    {
+        m_compiledGenes.clear();
+        m_compiledGenesPromoterLength = settings.promoterLength;
+        m_compiledGenesMaxChildren = settings.maxChildrenPerBranch;
+    }
+
+    geneIndex = loopIndex(geneIndex);
+    std::unordered_map<int, CompiledGene>::iterator i = m_compiledGenes.find(geneIndex);
+    if (i != m_compiledGenes.end())
+        return i->second;
+
+    CompiledGene & gene = m_compiledGenes[geneIndex];
+    compileGene(geneIndex, settings, &gene);
+    return gene;
+}
+
+
+void Genome::compileGene(int geneIndex, const TickSettings & settings, CompiledGene * gene) const
+{
+    gene->m_type = getTypeFrom2Nucleotides(geneIndex);
+    gene->m_angleReference = getAngleReference(getNucleotide(geneIndex + 2));
+    gene->m_angle = getSignedNumberFrom4Nucleotides(geneIndex + 3);
+    gene->m_growthRate = getUnsignedNumberFrom4Nucleotides(geneIndex + 7);
+    gene->m_length = getUnsignedNumberFrom4Nucleotides(geneIndex + 11);
+
+    if (gene->m_type != BRANCH)
+        return;
+
+    int promoterLength = settings.promoterLength;
+    int promotersStartIndex = geneIndex + 15; //Branch genes have 14 nucleotides before promoter references
+    for (int i = 0; i < settings.maxChildrenPerBranch; ++i)
+    {
+        int childGeneIndex = getIndexFromPromoter(geneIndex, promotersStartIndex + i * promoterLength, settings);
+
+        //getIndexFromPromoter returns negative one if a match is not found.
+        if (childGeneIndex != -1)
+            gene->m_childGeneIndices.push_back(childGeneIndex);
+    }
+}
+
+
+AngleReference Genome::getAngleReference(int nucleotide)
+{
+    switch (nucleotide)
+    {
+    case 1:
+    case 2:
+        return PARENT;
+    case 3:
+    default:
+        return VERTICAL;
+    }
+}
+
+
+
+//For each position i, this adds sign to the counter for its nucleotide n,
+//counts[4 * i + n].
+void Genome::addToNucleotideCounts(int * counts, int sign) const
+{
+    for (int i = 0; i < m_length; ++i)
+        counts[4 * i + getNucleotideWithoutLooping(i)] += sign;
+}
+
+
 QString Genome::outputAsString() const
 {
     QString output;
 
-    for (std::vector<char>::const_iterator i = m_nucleotides.begin(); i != m_nucleotides.end(); ++i)
+    for (int i = 0; i < m_length; ++i)
     {
-        switch (*i)
+        switch (getNucleotideWithoutLooping(i))
         {
         case 0:  output += 'A'; break;
         case 1:  output += 'C'; break;
@@ -169,10 +446,30 @@ QString Genome::outputAsString() const
 
 
 
+//This function reads a run of nucleotides as a base-4 number, first nucleotide
+//most significant.  The run must not wrap past the end of the genome and must
+//be short enough for the result to fit in an int.  Because of the packing
+//order, this is just a shift of at most two words.
+int Genome::getNucleotidesAsNumber(int index, int count) const
+{
+    int bits = 2 * count;
+    int offset = 2 * (index & 31);
+    int word = wordIndex(index);
+
+    uint64_t value = m_words[word] << offset;
+    if (offset + bits > 64)
+        value |= m_words[word + 1] >> (64 - offset);
+    return int(value >> (64 - bits));
+}
+
+
 //A group of 4 nucleotides can be read as a base-4 number of length 4.
 //This can be either signed (-128 to 127) or unsigned (0 to 255).
 int Genome::getUnsignedNumberFrom4Nucleotides(int index) const
 {
+    index = loopIndex(index);
+    if (index + 4 <= m_length)
+        return getNucleotidesAsNumber(index, 4);
     return 64 * getNucleotide(index) + 16 * getNucleotide(index+1) + 4 * getNucleotide(index+2) + getNucleotide(index+3);
 }
 int Genome::getSignedNumberFrom4Nucleotides(int index) const
@@ -184,8 +481,20 @@ int Genome::getSignedNumberFrom4Nucleotides(int index) const
 
 PlantPartType Genome::getTypeFrom2Nucleotides(int index) const
 {
-    char nucleotide1 = getNucleotide(index);
-    char nucleotide2 = getNucleotide(index + 1);
+    char nucleotide1;
+    char nucleotide2;
+    index = loopIndex(index);
+    if (index + 2 <= m_length)
+    {
+        int bothNucleotides = getNucleotidesAsNumber(index, 2);
+        nucleotide1 = char(bothNucleotides >> 2);
+        nucleotide2 = char(bothNucleotides & 3);
+    }
+    else
+    {
+        nucleotide1 = getNucleotide(index);
+        nucleotide2 = getNucleotide(index + 1);
+    }
 
     if (nucleotide2 >= 2)
         return NO_PART;
@@ -200,16 +509,26 @@ PlantPartType Genome::getTypeFrom2Nucleotides(int index) const
 }
 
 
+//Two nucleotides differ if either of their two bits differ.  XORing whole words
+//and folding each bit pair onto its low bit gives one set bit per difference, so
+//32 nucleotides are compared with a single popcount.
 int Genome::countDifferences(Genome * other) const
 {
-    int differenceCount = abs(other->getGenomeLength() - int(m_nucleotides.size()));
+    int differenceCount = abs(other->getGenomeLength() - m_length);
 
-    int shortestLength = std::min(other->getGenomeLength(), int(m_nucleotides.size()));
+    int shortestLength = std::min(other->getGenomeLength(), m_length);
+    int fullWords = shortestLength / 32;
+
+    for (int i = 0; i < fullWords; ++i)
+    {
+        uint64_t difference = m_words[i] ^ other->m_words[i];
+        differenceCount += popcount64((difference | (difference >> 1)) & 0x5555555555555555ULL);
+    }
 
-    for (int i = 0; i < shortestLength; ++i)
+    if (shortestLength % 32 != 0)
     {
-        if (m_nucleotides[i] != other->getNucleotide(i))
-            ++differenceCount;
+        uint64_t difference = (m_words[fullWords] ^ other->m_words[fullWords]) & getNucleotideRangeMask(fullWords, 0, shortestLength);
+        differenceCount += popcount64((difference | (difference >> 1)) & 0x5555555555555555ULL);
     }
 
     return differenceCount;
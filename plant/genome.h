@@ -20,54 +20,144 @@
 #define GENOME_H
 
 #include <vector>
+#include <unordered_map>
+#include <stdint.h>
 #include <QString>
 #include "../program/globals.h"
 
 #ifndef Q_MOC_RUN
 #include "boost/serialization/vector.hpp"
+#include "boost/serialization/split_member.hpp"
+#include "boost/serialization/version.hpp"
 #include "boost/archive/text_iarchive.hpp"
 #include "boost/archive/text_oarchive.hpp"
 #include "boost/shared_ptr.hpp"
 #endif // Q_MOC_RUN
 namespace boost {namespace serialization {class access;}}
 
+class TickSettings;
+
+//This is the decoded form of the gene that starts at one gene index.  The values
+//are the raw numbers from the genome, so they don't depend on the settings that
+//turn them into growth rates and lengths.
+struct CompiledGene
+{
+    PlantPartType m_type;
+    AngleReference m_angleReference;
+    int m_angle;
+    int m_growthRate;
+    int m_length;
+    std::vector<int> m_childGeneIndices; //Only used for branches.  Contains only promoters that were found.
+};
+
 class Genome
 {
 public:
-    Genome() {}
-    Genome(bool startingGenome, boost::shared_ptr<Genome> parent1, boost::shared_ptr<Genome> parent2);
+    Genome() : m_length(0), m_promoterIndexLength(-1), m_compiledGenesPromoterLength(-1), m_compiledGenesMaxChildren(-1) {}
+    Genome(const Genome & other) :
+        m_words(other.m_words), m_length(other.m_length),
+        m_promoterIndexLength(-1), m_compiledGenesPromoterLength(-1), m_compiledGenesMaxChildren(-1) {}
+    Genome & operator=(const Genome & other);
+    Genome(bool startingGenome, boost::shared_ptr<Genome> parent1, boost::shared_ptr<Genome> parent2,
+           RandomNumbers * randomNumbers);
 
-    void mutate();
-    void addNucleotide(char newNucleotide) {m_nucleotides.push_back(newNucleotide);}
-    int getIndexFromPromoter(int startingPoint, std::vector<char> * promoter) const;
-    int getGenomeLength() const {return int(m_nucleotides.size());}
+    void mutate(RandomNumbers * randomNumbers);
+    void addNucleotide(char newNucleotide);
+    int getIndexFromPromoter(int searchingIndex, int promoterIndex, const TickSettings & settings) const;
+    int getGenomeLength() const {return m_length;}
     QString outputAsString() const;
-    char getNucleotide(int index) const {return m_nucleotides[loopIndex(index)];}
+    char getNucleotide(int index) const {return getNucleotideWithoutLooping(loopIndex(index));}
+    void addToNucleotideCounts(int * counts, int sign) const;
     int getUnsignedNumberFrom4Nucleotides(int index) const;
     int getSignedNumberFrom4Nucleotides(int index) const;
     PlantPartType getTypeFrom2Nucleotides(int index) const;
+    const CompiledGene & getCompiledGene(int geneIndex, const TickSettings & settings) const;
     int countDifferences(Genome * other) const;
     int nextIndex(int index) const {return loopIndex(index + 1);}
     int previousIndex(int index) const {return loopIndex(index - 1);}
-    bool operator==(Genome other) const {return m_nucleotides == other.m_nucleotides;}
-    bool operator!=(Genome other) const {return !(*this == other);}
+    bool operator==(const Genome & other) const {return m_length == other.m_length && m_words == other.m_words;}
+    bool operator!=(const Genome & other) const {return !(*this == other);}
 
 private:
-    std::vector<char> m_nucleotides;
+    //Nucleotides are packed two bits each into 64-bit words, 32 per word.  The
+    //first nucleotide of a word occupies its two most significant bits, so a run
+    //of nucleotides read with a single shift comes out as a base-4 number in
+    //reading order.  Any unused bits in the last word are always kept as zero.
+    std::vector<uint64_t> m_words;
+    int m_length;
+
+    //For each possible promoter (4^promoterLength of them), this index holds the
+    //sorted positions in the genome where that promoter occurs.  It is stored as
+    //one positions array, with the positions for promoter p being those in
+    //[m_promoterBucketStarts[p], m_promoterBucketStarts[p+1]).  It is built the
+    //first time a promoter is looked up and discarded if the genome changes.
+    mutable std::vector<int> m_promoterBucketStarts;
+    mutable std::vector<int> m_promoterPositions;
+    mutable int m_promoterIndexLength;
+
+    //Genes are decoded the first time a plant part uses them and kept here,
+    //keyed by their looped gene index, so that building a plant is mostly
+    //table lookups.  Child gene indices depend on the promoter length and the
+    //maximum children per branch, so the values used are remembered too.
+    //Neither this nor the promoter index is copied with the genome: a copy
+    //starts without them and builds its own if it is used.
+    mutable std::unordered_map<int, CompiledGene> m_compiledGenes;
+    mutable int m_compiledGenesPromoterLength;
+    mutable int m_compiledGenesMaxChildren;
 
     //Since the genome is supposed to be effectively circular, this function is used to keep any
     //integer index in the genome's range.
     //http://stackoverflow.com/questions/12276675/modulus-with-negative-numbers-in-c
-    int loopIndex(int index) const {int size = int(m_nucleotides.size()); return (index % size + size) % size;}
+    int loopIndex(int index) const {int size = m_length; return (index % size + size) % size;}
 
-    void changeOneNucleotide(int index);
+    static int wordIndex(int index) {return index >> 5;}
+    static int bitShift(int index) {return 62 - 2 * (index & 31);}
+    char getNucleotideWithoutLooping(int index) const {return char((m_words[wordIndex(index)] >> bitShift(index)) & 3);}
+    void setNucleotide(int index, char nucleotide);
+    int getNucleotidesAsNumber(int index, int count) const;
+    void resize(int newLength);
+    void copyNucleotides(const Genome * source, int start, int end);
+    void copyPartOfWord(const Genome * source, int word, int start, int end, int copyEnd);
+    int getPromoterCode(int index, int promoterLength) const;
+    void buildPromoterIndex(int promoterLength) const;
+    int findPromoter(int startingPoint, int endingPoint, int promoterIndex, int promoterLength) const;
+    void compileGene(int geneIndex, const TickSettings & settings, CompiledGene * gene) const;
+    static AngleReference getAngleReference(int nucleotide);
+    void clearPromoterIndex() const {m_promoterBucketStarts.clear(); m_promoterPositions.clear(); m_promoterIndexLength = -1;}
+    void clearDecodedData();
 
     friend class boost::serialization::access;
+
+    //The packed words are archived as they are.  Files from before version 1
+    //stored one char per nucleotide.
     template<typename Archive>
-    void serialize(Archive & ar, const unsigned)
+    void save(Archive & ar, const unsigned) const
     {
-        ar & m_nucleotides;
+        ar & m_length;
+        ar & m_words;
     }
+    template<typename Archive>
+    void load(Archive & ar, const unsigned version)
+    {
+        clearDecodedData();
+        if (version < 1)
+        {
+            std::vector<char> nucleotides;
+            ar & nucleotides;
+            m_words.clear();
+            m_length = 0;
+            for (std::vector<char>::const_iterator i = nucleotides.begin(); i != nucleotides.end(); ++i)
+                addNucleotide(*i);
+        }
+        else
+        {
+            ar & m_length;
+            ar & m_words;
+        }
+    }
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
 };
 
+BOOST_CLASS_VERSION(Genome, 1)
+
 #endif // GENOME_H
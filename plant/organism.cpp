@@ -24,51 +24,61 @@
 #include "seed.h"
 #include "genome.h"
 #include "../settings/environmentsettings.h"
+#include "../settings/ticksettings.h"
 #include "../program/point2d.h"
 #include "../program/stats.h"
 #include <algorithm>    // std::sort
 
 //This constructor makes the initial batch of organisms.
-Organism::Organism(double energy, long long elapsedTime, double xPos) :
+Organism::Organism(double energy, long long elapsedTime, double xPos, const TickSettings & settings) :
     m_energy(energy),
-    m_genome(new Genome(true, boost::shared_ptr<Genome>(), boost::shared_ptr<Genome>())),
+    m_genome(new Genome(true, boost::shared_ptr<Genome>(), boost::shared_ptr<Genome>(), g_randomNumbers)),
     m_birthDate(elapsedTime), m_generation(1.0),
     m_randomness(g_simulationSettings->growthRandomness), m_historyOrganism(false),
     m_energyFromPhotosynthesis(0.0), m_energySpentOnGrowthAndMaintenance(0.0), m_energySpentOnReproduction(0.0),
-    m_firstPart(new PlantPart(this, 0, 0, Point2D(xPos, 0.0))),
-    m_helped(false)
+    m_firstPart(new PlantPart(this, 0, 0, Point2D(xPos, 0.0), settings, g_randomNumbers)),
+    m_helped(false), m_settled(false), m_countedAsGrown(false)
 {
-    setColorsWithRandomness();
+    countPlantParts();
+    setColorsWithRandomness(g_randomNumbers);
 }
 
 
 //This constructor makes most organisms - those with two parents.
-Organism::Organism(Seed &seed1, Seed &seed2, long long elapsedTime, double xPos) :
-    m_genome(new Genome(false, seed1.m_genome, seed2.m_genome)),
+//It only uses the given random number generator, so organisms can be made in
+//parallel.
+Organism::Organism(Seed &seed1, Seed &seed2, long long elapsedTime, double xPos,
+                   const TickSettings & settings, RandomNumbers * randomNumbers) :
+    m_genome(new Genome(false, seed1.m_genome, seed2.m_genome, randomNumbers)),
     m_birthDate(elapsedTime),
     m_generation((seed1.getGeneration() + seed2.getGeneration()) / 2.0 + 1.0),
     m_randomness(g_simulationSettings->growthRandomness), m_historyOrganism(false),
     m_energyFromPhotosynthesis(0.0), m_energySpentOnGrowthAndMaintenance(0.0), m_energySpentOnReproduction(0.0),
-    m_firstPart(new PlantPart(this, 0, 0, Point2D(xPos, 0.0))),
-    m_helped(false)
+    m_firstPart(new PlantPart(this, 0, 0, Point2D(xPos, 0.0), settings, randomNumbers)),
+    m_helped(false), m_settled(false), m_countedAsGrown(false)
 {
+    countPlantParts();
+
     //The amount of energy going into the plant is limited by the seed
     //with the least energy.
     double minSeedEnergy = std::min(seed1.getEnergy(), seed2.getEnergy());
     m_energy = 2.0 * minSeedEnergy;
 
-    setColorsWithRandomness();
+    setColorsWithRandomness(randomNumbers);
 }
 
 
 //This constructor makes the organisms that are stored in the Stats object.
-Organism::Organism(Genome genome, double generation) :
+//History organisms have no growth randomness, so they are given no random
+//numbers, and they may be grown in the background.
+Organism::Organism(Genome genome, double generation, const TickSettings & settings) :
     m_energy(0.0), m_genome(new Genome(genome)),
     m_generation(generation), m_randomness(0.0), m_historyOrganism(true),
     m_energyFromPhotosynthesis(0.0), m_energySpentOnGrowthAndMaintenance(0.0), m_energySpentOnReproduction(0.0),
-    m_helped(false)
+    m_helped(false), m_settled(false), m_countedAsGrown(false)
 {
-    m_firstPart = new PlantPart(this, 0, 0, Point2D(0.0, 0.0));
+    m_firstPart = new PlantPart(this, 0, 0, Point2D(0.0, 0.0), settings, 0);
+    countPlantParts();
     setColorsWithoutRandomness();
 }
 
@@ -80,7 +90,7 @@ Organism::~Organism()
 
 
 
-void Organism::setColorsWithRandomness()
+void Organism::setColorsWithRandomness(RandomNumbers * randomNumbers)
 {
     int branchHue, branchSaturation, branchLightness;
     g_simulationSettings->branchFillColor.getHsl(&branchHue, &branchSaturation, &branchLightness);
@@ -91,21 +101,21 @@ void Organism::setColorsWithRandomness()
     int maxBranchVariation = g_simulationSettings->branchColorVariation;
     int minBranchVariation = -1 * g_simulationSettings->branchColorVariation;
 
-    int newBranchHue = branchHue + g_randomNumbers->getRandomInt(minBranchVariation, maxBranchVariation);
+    int newBranchHue = branchHue + randomNumbers->getRandomInt(minBranchVariation, maxBranchVariation);
     newBranchHue = constrainNumber(newBranchHue, 0, 359);
-    int newBranchSaturation = branchSaturation + g_randomNumbers->getRandomInt(minBranchVariation, maxBranchVariation);
+    int newBranchSaturation = branchSaturation + randomNumbers->getRandomInt(minBranchVariation, maxBranchVariation);
     newBranchSaturation = constrainNumber(newBranchSaturation, 0, 255);
-    int newBranchLightness = branchLightness + g_randomNumbers->getRandomInt(minBranchVariation, maxBranchVariation);
+    int newBranchLightness = branchLightness + randomNumbers->getRandomInt(minBranchVariation, maxBranchVariation);
     newBranchLightness = constrainNumber(newBranchLightness, 0, 255);
 
     int maxLeafVariation = g_simulationSettings->leafColorVariation;
     int minLeafVariation = -1 * g_simulationSettings->leafColorVariation;
 
-    int newLeafHue = leafHue + g_randomNumbers->getRandomInt(minLeafVariation, maxLeafVariation);
+    int newLeafHue = leafHue + randomNumbers->getRandomInt(minLeafVariation, maxLeafVariation);
     newLeafHue = constrainNumber(newLeafHue, 0, 359);
-    int newLeafSaturation = leafSaturation + g_randomNumbers->getRandomInt(minLeafVariation, maxLeafVariation);
+    int newLeafSaturation = leafSaturation + randomNumbers->getRandomInt(minLeafVariation, maxLeafVariation);
     newLeafSaturation = constrainNumber(newLeafSaturation, 0, 255);
-    int newLeafLightness = leafLightness + g_randomNumbers->getRandomInt(minLeafVariation, maxLeafVariation);
+    int newLeafLightness = leafLightness + randomNumbers->getRandomInt(minLeafVariation, maxLeafVariation);
     newLeafLightness = constrainNumber(newLeafLightness, 0, 255);
 
     QColor branchColor;
@@ -297,14 +307,16 @@ void Organism::drawSeedpods(QPainter * painter, bool highlight, bool helpingLaye
     }
 }
 
-void Organism::growOneTick()
+//Growth only uses the given random number generator (for new plant parts), so
+//organisms can be grown in parallel.
+void Organism::growOneTick(const TickSettings & settings, RandomNumbers * randomNumbers)
 {
-    m_firstPart->growOneTick();
+    m_firstPart->growOneTick(settings, randomNumbers);
 }
 
-void Organism::transmitLoadAndGrowWidthOneTick()
+void Organism::transmitLoadAndGrowWidthOneTick(const TickSettings & settings)
 {
-    m_firstPart->calculateCenterOfMass();
+    m_firstPart->calculateCenterOfMass(settings);
 }
 
 void Organism::addLeavesToLightingVector(std::vector<PlantPart *> * leaves)
@@ -312,44 +324,81 @@ void Organism::addLeavesToLightingVector(std::vector<PlantPart *> * leaves)
     m_firstPart->addLeavesToLightingVector(leaves);
 }
 
-void Organism::useEnergyOneTick()
+void Organism::useEnergyOneTick(const TickSettings & settings)
 {
     if (!m_historyOrganism)
     {
-        double maintenanceCost = getMaintenanceCost();
+        double maintenanceCost = getMaintenanceCost(settings);
         m_energy -= maintenanceCost;
         m_energySpentOnGrowthAndMaintenance += maintenanceCost;
     }
 }
 
-double Organism::getMaintenanceCost() const
+//This does the same as growOneTick, transmitLoadAndGrowWidthOneTick and
+//useEnergyOneTick, but is only used at night.  Once an organism is settled,
+//the first two would do nothing, so they are skipped and the maintenance cost
+//from the last full tick is used.  Every organism is checked again on the first
+//tick of each night and whenever any of the tick settings change.
+void Organism::advanceOneNightTick(const TickSettings & settings, bool firstTickOfNight, RandomNumbers * randomNumbers)
 {
-    return g_simulationSettings->organismMaintenanceCost + m_firstPart->getMaintenanceCost();
+    if (firstTickOfNight || !m_settled || settings.generation != m_settledSettingsGeneration)
+    {
+        growOneTick(settings, randomNumbers);
+        bool widthChanged = m_firstPart->calculateCenterOfMass(settings);
+        m_settled = !widthChanged && isFinishedGrowing();
+        m_settledSettingsGeneration = settings.generation;
+        m_settledMaintenanceCost = getMaintenanceCost(settings);
+    }
+
+    if (!m_historyOrganism)
+    {
+        m_energy -= m_settledMaintenanceCost;
+        m_energySpentOnGrowthAndMaintenance += m_settledMaintenanceCost;
+    }
+}
+
+double Organism::getMaintenanceCost(const TickSettings & settings) const
+{
+    return settings.organismMaintenanceCost + m_firstPart->getMaintenanceCost(settings);
 }
 
 
 //The rate at which the plant can make seeds is a function of its current energy.
 //More energy means greater seed production.
-void Organism::createSeeds(std::deque<Seed> *seeds, long long elapsedTime, bool dayTime)
+//Seeds are only made during the day, so at night this returns without drawing
+//any random numbers.
+void Organism::createSeeds(std::vector<Seed> *seeds, long long elapsedTime, bool dayTime,
+                           const TickSettings & settings, RandomNumbers * randomNumbers)
 {
-    double seedProductionAdjustment = getEnergy() / (getMaintenanceCost() * 100.0);
-    double seedProductionRate = seedProductionAdjustment * g_simulationSettings->newSeedsPerTickPerSeedpod;
+    if (!dayTime)
+        return;
+
+    double seedProductionAdjustment = getEnergy() / (getMaintenanceCost(settings) * 100.0);
+    double seedProductionRate = seedProductionAdjustment * settings.newSeedsPerTickPerSeedpod;
 
-    m_firstPart->createSeeds(seeds, elapsedTime, dayTime, seedProductionRate);
+    m_firstPart->createSeeds(seeds, elapsedTime, dayTime, seedProductionRate, settings, randomNumbers);
 }
 
-void Organism::age(int ticksToAge)
+//This grows a history organism for up to the given number of ticks.  Once all
+//of its parts have finished growing and a load pass doesn't widen any branch,
+//no further tick can change it, so it stops there.  History organisms are aged
+//for thousands of ticks but are usually mature after a small fraction of that.
+//Branch widths depend on the load at every tick while parts are growing, so
+//the ticks before that point can't be skipped without changing the result.
+void Organism::age(int ticksToAge, const TickSettings & settings)
 {
     for (int i = 0; i < ticksToAge; ++i)
     {
-        growOneTick();
-        transmitLoadAndGrowWidthOneTick();
+        growOneTick(settings, 0);
+        bool widthChanged = m_firstPart->calculateCenterOfMass(settings);
+        if (!widthChanged && isFinishedGrowing())
+            break;
     }
 }
 
 bool Organism::isFinishedGrowing() const
 {
-    return m_firstPart->isFinishedGrowing();
+    return m_growingPartCount == 0;
 }
 
 double Organism::getHeight() const
@@ -393,22 +442,46 @@ long long Organism::getAge(long long elapsedTime) const
 
 int Organism::getLeafCount() const
 {
-    return m_firstPart->getLeafCount();
+    return m_leafCount;
 }
 
 int Organism::getBranchCount() const
 {
-    return m_firstPart->getBranchCount();
+    return m_branchCount;
 }
 
 int Organism::getSeedpodCount() const
 {
-    return m_firstPart->getSeedpodCount();
+    return m_seedpodCount;
 }
 
 int Organism::getPlantPartCount() const
 {
-    return m_firstPart->getPlantPartCount();
+    return m_plantPartCount;
+}
+
+//New parts always start out growing.
+void Organism::plantPartAdded(PlantPartType partType)
+{
+    if (partType == BRANCH)
+        ++m_branchCount;
+    else if (partType == LEAF)
+        ++m_leafCount;
+    else if (partType == SEEDPOD)
+        ++m_seedpodCount;
+    ++m_plantPartCount;
+    ++m_growingPartCount;
+}
+
+void Organism::countPlantParts()
+{
+    m_branchCount = 0;
+    m_leafCount = 0;
+    m_seedpodCount = 0;
+    m_plantPartCount = 0;
+    m_growingPartCount = 0;
+    m_firstPart->addToPartCounts(&m_branchCount, &m_leafCount, &m_seedpodCount,
+                                 &m_plantPartCount, &m_growingPartCount);
 }
 
 double Organism::getMass() const
@@ -29,6 +29,7 @@
 #include "../program/globals.h"
 #include "../program/point2d.h"
 #include "genome.h"
+#include "plantpart.h"
 #include "../program/globals.h"
 
 #ifndef Q_MOC_RUN
@@ -37,31 +38,36 @@
 #include "boost/archive/text_iarchive.hpp"
 #include "boost/shared_ptr.hpp"
 #include "boost/serialization/shared_ptr.hpp"
+#include "boost/serialization/version.hpp"
 #endif // Q_MOC_RUN
 namespace boost {namespace serialization {class access;}}
 
-class PlantPart;
 class Environment;
 class Seed;
 class GeneAnnotation;
+class RandomNumbers;
+class TickSettings;
 
 class Organism : boost::noncopyable
 {
 public:
-    Organism() {}
-    Organism(double energy, long long elapsedTime, double xPos);
-    Organism(Seed & seed1, Seed & seed2, long long elapsedTime, double xPos);
-    Organism(Genome genome, double generation);
+    Organism() : m_settled(false), m_countedAsGrown(false) {}
+    Organism(double energy, long long elapsedTime, double xPos, const TickSettings & settings);
+    Organism(Seed & seed1, Seed & seed2, long long elapsedTime, double xPos,
+             const TickSettings & settings, RandomNumbers * randomNumbers);
+    Organism(Genome genome, double generation, const TickSettings & settings);
     ~Organism();
 
-    void growOneTick();
-    void transmitLoadAndGrowWidthOneTick();
-    void useEnergyOneTick();
-    double getMaintenanceCost() const;
+    void growOneTick(const TickSettings & settings, RandomNumbers * randomNumbers);
+    void transmitLoadAndGrowWidthOneTick(const TickSettings & settings);
+    void useEnergyOneTick(const TickSettings & settings);
+    void advanceOneNightTick(const TickSettings & settings, bool firstTickOfNight, RandomNumbers * randomNumbers);
+    double getMaintenanceCost(const TickSettings & settings) const;
     void deductEnergy(double energyToDeduct) {m_energy -= energyToDeduct;}
     void addEnergy(double energyToAdd) {m_energy += energyToAdd;}
-    void age(int ticksToAge);
-    void createSeeds(std::deque<Seed> * seeds, long long elapsedTime, bool dayTime);
+    void age(int ticksToAge, const TickSettings & settings);
+    void createSeeds(std::vector<Seed> * seeds, long long elapsedTime, bool dayTime,
+                     const TickSettings & settings, RandomNumbers * randomNumbers);
     void addToEnergyFromPhotosynthesis(double energy) {m_energyFromPhotosynthesis += energy;}
     void addToEnergySpentOnGrowthAndMaintenance(double energy) {m_energySpentOnGrowthAndMaintenance += energy;}
     void addToEnergySpentOnReproduction(double energy) {m_energySpentOnReproduction += energy;}
@@ -80,7 +86,7 @@ public:
     double getLeftmostDrawnPoint() const;
     double getEnergy() const {return m_energy;}
     void setEnergy(double newEnergy)  {m_energy = newEnergy;}
-    boost::shared_ptr<Genome> getGenomeSharedPointer() {return m_genome;}
+    boost::shared_ptr<Genome> getGenomeSharedPointer() const {return m_genome;}
     Genome * getGenome() const {return m_genome.get();}
     double getGeneration() const {return m_generation;}
     double getRandomness() const {return m_randomness;}
@@ -94,6 +100,10 @@ public:
     double getEnergySpentOnGrowthAndMaintenance() const {return m_energySpentOnGrowthAndMaintenance;}
     double getEnergySpentOnReproduction() const {return m_energySpentOnReproduction;}
     bool isHelped() const {return m_helped;}
+    void plantPartAdded(PlantPartType partType);
+    void plantPartFinishedGrowing() {--m_growingPartCount;}
+    bool isCountedAsGrown() const {return m_countedAsGrown;}
+    void setCountedAsGrown(bool countedAsGrown) {m_countedAsGrown = countedAsGrown;}
 
 private:
     double m_energy;
@@ -110,6 +120,30 @@ private:
     PlantPart * m_firstPart;
     bool m_helped;
 
+    //These are used by night ticks.  An organism is settled when it has finished
+    //growing and its branches have stopped widening, in which case growth and
+    //load transmission can't change it and its maintenance cost stays the same,
+    //as long as the settings (see TickSettings::generation) don't change.
+    //They aren't saved, as they are worked out again on the next night.
+    bool m_settled;
+    int m_settledSettingsGeneration;
+    double m_settledMaintenanceCost;
+
+    //Part counts are kept up to date as the organism grows, as they are needed
+    //every time a part is made.  An organism has finished growing when none of
+    //its parts are still growing.  They aren't saved, as they are counted again
+    //when the organism is loaded.
+    int m_branchCount;
+    int m_leafCount;
+    int m_seedpodCount;
+    int m_plantPartCount;
+    int m_growingPartCount;
+
+    //True if the environment has added this organism to its running totals of
+    //fully grown organisms.  Not saved, as the totals are worked out again when
+    //a simulation is loaded.
+    bool m_countedAsGrown;
+
     void drawBranches(QPainter * painter, bool highlight, bool helpingLayer,
                       std::vector<QLineF> * branchLines, std::vector<double> * branchWidths,
                       QColor * branchFillColor, QColor * branchLineColor) const;
@@ -118,17 +152,21 @@ private:
     void drawSeedpods(QPainter * painter, bool highlight, bool helpingLayer,
                       std::vector<QLineF> * seedpodsLines,
                       std::vector<QRectF> * seedpodsEnds) const;
-    void setColorsWithRandomness();
+    void setColorsWithRandomness(RandomNumbers * randomNumbers);
     void setColorsWithoutRandomness();
+    void countPlantParts();
     int constrainNumber(int number, int min, int max) const;
 
     friend class boost::serialization::access;
     template<typename Archive>
-    void serialize(Archive & ar, const unsigned)
+    void serialize(Archive & ar, const unsigned version)
     {
         ar & m_energy;
         ar & m_genome;
-        ar & m_firstPart;
+        if (version < 1)
+            ar & m_firstPart;
+        else
+            PlantPart::serializeTree(ar, &m_firstPart, this);
         ar & m_birthDate;
         ar & m_generation;
         ar & m_randomness;
@@ -144,6 +182,9 @@ private:
         ar & m_energySpentOnReproduction;
         ar & m_helped;
 
+        if (Archive::is_loading::value)
+            countPlantParts();
+
         if (isHistoryOrganism())
             ++g_historyOrganismsSavedOrLoaded;
         else
@@ -151,4 +192,6 @@ private:
     }
 };
 
+BOOST_CLASS_VERSION(Organism, 1)
+
 #endif // ORGANISM_H
@@ -22,16 +22,17 @@
 #include "genome.h"
 #include "../program/randomnumbers.h"
 #include "../settings/environmentsettings.h"
-#include "../program/stats.h"
+#include "../settings/ticksettings.h"
 #include "seed.h"
 
 PlantPart::PlantPart(Organism * organism, PlantPart * parent, int geneIndex,
-                     Point2D start) :
+                     Point2D start, const TickSettings & settings, RandomNumbers * randomNumbers) :
     m_organism(organism), m_parent(parent),
     m_start(start), m_end(start), m_geneIndex(geneIndex), m_finishedGrowing(false),
     m_centreOfMass(start), m_mass(0.0), m_previousLengthOrArea(0.0), m_width(1.0)
 {
-    m_type = m_organism->getGenome()->getTypeFrom2Nucleotides(geneIndex);
+    const CompiledGene & gene = m_organism->getGenome()->getCompiledGene(geneIndex, settings);
+    m_type = gene.m_type;
 
     if (m_type == NO_PART)
     {
@@ -40,18 +41,18 @@ PlantPart::PlantPart(Organism * organism, PlantPart * parent, int geneIndex,
     }
 
     //Get part parameters from the genome.
-    AngleReference angleReference = getAngleReference(m_organism->getGenome()->getNucleotide(geneIndex + 2));
-    double angleFromGenome = m_organism->getGenome()->getSignedNumberFrom4Nucleotides(geneIndex + 3);
-    double growthRate = m_organism->getGenome()->getUnsignedNumberFrom4Nucleotides(geneIndex + 7);
-    growthRate = growthRate * g_simulationSettings->growRateGeneRatio / 100.0 + g_simulationSettings->minimumGrowthRate;
+    AngleReference angleReference = gene.m_angleReference;
+    double angleFromGenome = gene.m_angle;
+    double growthRate = gene.m_growthRate;
+    growthRate = growthRate * settings.growRateGeneRatio / 100.0 + settings.minimumGrowthRate;
 
     if (m_type == LEAF)
-        m_finalLength = g_simulationSettings->leafLength;
+        m_finalLength = settings.leafLength;
     else
     {
-        m_finalLength = m_organism->getGenome()->getUnsignedNumberFrom4Nucleotides(geneIndex + 11) + g_simulationSettings->minimumPlantPartLength;
+        m_finalLength = gene.m_length + settings.minimumPlantPartLength;
         if (m_type == SEEDPOD)
-            m_finalLength /= g_simulationSettings->seedpodLengthScale;
+            m_finalLength /= settings.seedpodLengthScale;
     }
 
     //Add randomness to the angle and the growth rate.
@@ -59,11 +60,11 @@ PlantPart::PlantPart(Organism * organism, PlantPart * parent, int geneIndex,
     if (randomness > 0.0)
     {
         double randomAngleRange = 360.0 * m_organism->getRandomness();
-        angleFromGenome += g_randomNumbers->getRandomDouble(-1.0 * randomAngleRange, randomAngleRange);
+        angleFromGenome += randomNumbers->getRandomDouble(-1.0 * randomAngleRange, randomAngleRange);
         double randomGrowthRateRange = growthRate * m_organism->getRandomness();
-        growthRate += g_randomNumbers->getRandomDouble(-1.0 * randomGrowthRateRange, randomGrowthRateRange);
+        growthRate += randomNumbers->getRandomDouble(-1.0 * randomGrowthRateRange, randomGrowthRateRange);
         double randomLengthRange = m_finalLength * m_organism->getRandomness();
-        m_finalLength += g_randomNumbers->getRandomDouble(-1.0 * randomLengthRange, randomLengthRange);
+        m_finalLength += randomNumbers->getRandomDouble(-1.0 * randomLengthRange, randomLengthRange);
     }
 
     //Determine the X and Y that will be changed with daily growth.
@@ -83,24 +84,11 @@ PlantPart::~PlantPart()
 }
 
 
-AngleReference PlantPart::getAngleReference(int nucleotide)
-{
-    switch (nucleotide)
-    {
-    case 1:
-    case 2:
-        return PARENT;
-    case 3:
-    default:
-        return VERTICAL;
-    }
-}
-
-void PlantPart::growOneTick()
+void PlantPart::growOneTick(const TickSettings & settings, RandomNumbers * randomNumbers)
 {
     if (m_finishedGrowing)
     {
-        growChildParts();
+        growChildParts(settings, randomNumbers);
         return;
     }
     m_end += m_dailyGrowth;
@@ -110,7 +98,7 @@ void PlantPart::growOneTick()
     if (m_end.m_y < 0.0)
     {
         m_end -= m_dailyGrowth;
-        m_finishedGrowing = true;
+        finishGrowing();
         return;
     }
 
@@ -125,16 +113,16 @@ void PlantPart::growOneTick()
         m_end.m_x = m_start.m_x + m_finalLength * cos(angleRadians);
         m_end.m_y = m_start.m_y + m_finalLength * sin(angleRadians);
 
-        m_finishedGrowing = true;
+        finishGrowing();
 
-        createChildParts();
+        createChildParts(settings, randomNumbers);
     }
 
     //Now deduct from the organism the energy used in growth.
 
     if (!m_organism->isHistoryOrganism())
     {
-        double growthCost = getGrowthCost();
+        double growthCost = getGrowthCost(settings);
         m_organism->deductEnergy(growthCost);
         m_organism->addToEnergySpentOnGrowthAndMaintenance(growthCost);
     }
@@ -143,6 +131,16 @@ void PlantPart::growOneTick()
 
 
 
+//The organism keeps count of its parts that are still growing, so it can tell
+//when it has finished growing without searching its whole tree.
+void PlantPart::finishGrowing()
+{
+    m_finishedGrowing = true;
+    m_organism->plantPartFinishedGrowing();
+}
+
+
+
 bool PlantPart::descendsFromGeneIndex(double otherGeneIndex) const
 {
     if (otherGeneIndex == m_geneIndex)
@@ -175,7 +173,7 @@ double PlantPart::distanceFromPointToLineSegment(const Point2D v, const Point2D
 
 
 
-double PlantPart::getGrowthCost()
+double PlantPart::getGrowthCost(const TickSettings & settings)
 {
     double currentLengthOrArea;
     if (m_type == BRANCH)
@@ -187,30 +185,30 @@ double PlantPart::getGrowthCost()
     m_previousLengthOrArea = currentLengthOrArea;
 
     if (m_type == BRANCH)
-        return lengthOrAreaGrown * g_simulationSettings->branchGrowthCost;
+        return lengthOrAreaGrown * settings.branchGrowthCost;
     else if (m_type == LEAF)
-        return lengthOrAreaGrown * g_simulationSettings->leafGrowthCost;
+        return lengthOrAreaGrown * settings.leafGrowthCost;
     else //SEEDPOD
-        return lengthOrAreaGrown * g_simulationSettings->seedpodGrowthCost;
+        return lengthOrAreaGrown * settings.seedpodGrowthCost;
 }
 
 
 
-double PlantPart::getMaintenanceCost() const
+double PlantPart::getMaintenanceCost(const TickSettings & settings) const
 {
-    double maintenanceCost = g_simulationSettings->plantPartMaintenanceCost;
+    double maintenanceCost = settings.plantPartMaintenanceCost;
 
     if (m_type == BRANCH)
     {
-        maintenanceCost += getArea() * g_simulationSettings->branchMaintenanceCost;
+        maintenanceCost += getArea() * settings.branchMaintenanceCost;
         for (std::vector<PlantPart *>::const_iterator i = m_children.begin(); i != m_children.end(); ++i)
-            maintenanceCost += (*i)->getMaintenanceCost();
+            maintenanceCost += (*i)->getMaintenanceCost(settings);
 
     }
     else if (m_type == LEAF)
-        maintenanceCost += getLength() * g_simulationSettings->leafMaintenanceCost;
+        maintenanceCost += getLength() * settings.leafMaintenanceCost;
     else //SEEDPOD
-        maintenanceCost += getLength() * g_simulationSettings->seedpodMaintenanceCost;
+        maintenanceCost += getLength() * settings.seedpodMaintenanceCost;
 
     return maintenanceCost;
 }
@@ -219,26 +217,27 @@ double PlantPart::getMaintenanceCost() const
 
 //This code looks at the genome to determine which (if any) child PlantParts need
 //to be created, and then it creates them.  It only does anything for branches.
-void PlantPart::createChildParts()
+//The allowLoops setting is a template parameter so each version has its loop
+//check compiled in or out.
+void PlantPart::createChildParts(const TickSettings & settings, RandomNumbers * randomNumbers)
 {
     if (m_type != BRANCH)
         return;
 
-    int thisGeneIndex = getGeneIndex();
-    int promotersStartIndex = thisGeneIndex + 15; //Branch genes have 14 nucleotides before promoter references
-    Genome * genome = getOrganism()->getGenome();
-
-    for (int i = 0; i < g_simulationSettings->maxChildrenPerBranch; ++i)
-    {
-        std::vector<char> promoter;
-        for (int j = 0; j < g_simulationSettings->promoterLength; ++j)
-            promoter.push_back(genome->getNucleotide(promotersStartIndex + i * g_simulationSettings->promoterLength + j));
+    if (settings.allowLoops)
+        createChildParts<true>(settings, randomNumbers);
+    else
+        createChildParts<false>(settings, randomNumbers);
+}
 
-        int childGeneIndex = getOrganism()->getGenome()->getIndexFromPromoter(thisGeneIndex, &promoter);
+template <bool allowLoops>
+void PlantPart::createChildParts(const TickSettings & settings, RandomNumbers * randomNumbers)
+{
+    const std::vector<int> & childGeneIndices = getOrganism()->getGenome()->getCompiledGene(getGeneIndex(), settings).m_childGeneIndices;
 
-        //The Genome::getGeneIndexFromPromoter function returns negative one if a match is not found.
-        if (childGeneIndex == -1)
-            continue;
+    for (std::vector<int>::const_iterator i = childGeneIndices.begin(); i != childGeneIndices.end(); ++i)
+    {
+        int childGeneIndex = *i;
 
         //Create the child PlantParts, but do not allow any direct duplicates.  I.e. two children
         //cannot have the same gene index.  This would result in them always growing exactly on top
@@ -254,51 +253,55 @@ void PlantPart::createChildParts()
             }
         }
         if (!geneIndexAlreadyUsed)
-            createOneChildPart(childGeneIndex);
+            createOneChildPart<allowLoops>(childGeneIndex, settings, randomNumbers);
     }
 }
 
-void PlantPart::createOneChildPart(int childGeneIndex)
+template <bool allowLoops>
+void PlantPart::createOneChildPart(int childGeneIndex, const TickSettings & settings,
+                                   RandomNumbers * randomNumbers)
 {
     //If the gene's has no type, then no child is made.
-    if (getOrganism()->getGenome()->getTypeFrom2Nucleotides(childGeneIndex) == NO_PART)
+    if (getOrganism()->getGenome()->getCompiledGene(childGeneIndex, settings).m_type == NO_PART)
         return;
 
     //If the organism has already reached the maximum number of plant parts,
     //then no child is made.
-    if (getOrganism()->getPlantPartCount() >= g_simulationSettings->maxPlantPartsPerOrganism)
+    if (getOrganism()->getPlantPartCount() >= settings.maxPlantPartsPerOrganism)
         return;
 
     //Whether or not a loop (child having the same gene index as the parent) is allowed is
     //determined by a setting.
-    if ( !(g_simulationSettings->allowLoops) )
+    if (!allowLoops)
     {
         if (descendsFromGeneIndex(childGeneIndex))
             return;
     }
 
-    m_children.push_back(new PlantPart(m_organism, this, childGeneIndex, m_end));
+    m_children.push_back(new PlantPart(m_organism, this, childGeneIndex, m_end, settings, randomNumbers));
+    m_organism->plantPartAdded(m_children.back()->getType());
 }
 
 
 
 
-void PlantPart::growChildParts()
+void PlantPart::growChildParts(const TickSettings & settings, RandomNumbers * randomNumbers)
 {
     for (std::vector<PlantPart *>::iterator i = m_children.begin(); i != m_children.end(); ++i)
-        (*i)->growOneTick();
+        (*i)->growOneTick(settings, randomNumbers);
 }
 
 
 
 
 
-void PlantPart::createSeeds(std::deque<Seed> *seeds, long long elapsedTime, bool dayTime, double seedProductionRate)
+void PlantPart::createSeeds(std::vector<Seed> *seeds, long long elapsedTime, bool dayTime, double seedProductionRate,
+                            const TickSettings & settings, RandomNumbers * randomNumbers)
 {
     if (m_type == BRANCH)
     {
         for (std::vector<PlantPart *>::iterator i = m_children.begin(); i != m_children.end(); ++i)
-            (*i)->createSeeds(seeds, elapsedTime, dayTime, seedProductionRate);
+            (*i)->createSeeds(seeds, elapsedTime, dayTime, seedProductionRate, settings, randomNumbers);
     }
 
     else if (m_type == SEEDPOD)
@@ -309,7 +312,12 @@ void PlantPart::createSeeds(std::deque<Seed> *seeds, long long elapsedTime, bool
         double length = getLength();
         double seedEnergy = length * length;
 
-        int seedCount = g_randomNumbers->changeDoubleToProbabilisticInt(seedProductionRate);
+        //If the organism can't afford even one seed, there's no need to draw the
+        //seed count.
+        if (seedEnergy >= getOrganism()->getEnergy() || !dayTime)
+            return;
+
+        int seedCount = randomNumbers->changeDoubleToProbabilisticInt(seedProductionRate);
 
         for (int i = 0; i < seedCount; ++i)
         {
@@ -320,30 +328,34 @@ void PlantPart::createSeeds(std::deque<Seed> *seeds, long long elapsedTime, bool
                 seeds->emplace_back(seedEnergy, getOrganism()->getGenomeSharedPointer(), elapsedTime, getOrganism()->getGeneration());
 
                 //Deduct the energy from the Organism.
-                double totalEnergyCost = seedEnergy + g_simulationSettings->seedCreationCost;
+                double totalEnergyCost = seedEnergy + settings.seedCreationCost;
                 m_organism->deductEnergy(totalEnergyCost);
                 m_organism->addToEnergySpentOnReproduction(totalEnergyCost);
-
-                ++(g_stats->m_numberOfSeedsGenerated);
             }
         }
     }
 }
 
 
-
-void PlantPart::calculateCenterOfMass()
+//This updates the mass and centre of mass for this part and everything above
+//it, widening any branches that can't hold their load.  It returns true if any
+//branch was widened.
+bool PlantPart::calculateCenterOfMass(const TickSettings & settings)
 {
     if (m_type == BRANCH)
     {
         //First deal with any PlantParts above this one.
+        bool widthChanged = false;
         for (std::vector<PlantPart *>::iterator i = m_children.begin(); i != m_children.end(); ++i)
-            (*i)->calculateCenterOfMass();
+        {
+            if ((*i)->calculateCenterOfMass(settings))
+                widthChanged = true;
+        }
 
         //Determine the mass and centre of mass for this branch and all parts above it.
         //The mass is found by simply adding up all the masses.  The centre of mass is
         //found by doing a weighted average.
-        double massOfOnlyThisBranch = getArea() * g_simulationSettings->branchDensity + 1.0;  //Add one to prevent zero-mass PlantParts
+        double massOfOnlyThisBranch = getArea() * settings.branchDensity + 1.0;  //Add one to prevent zero-mass PlantParts
         Point2D average = ((m_start + m_end) / 2.0) * massOfOnlyThisBranch;
 
         double totalMass = massOfOnlyThisBranch;
@@ -362,22 +374,26 @@ void PlantPart::calculateCenterOfMass()
         //Determine the load on the branch.  Load is a sum of mass and torque.  The
         //torque is scaled by a scaling factor so its influence on load can be changed.
         double torque = (m_start.m_x - average.m_x) * totalMass;
-        double load = totalMass + fabs(torque) * g_simulationSettings->torqueScalingFactor;
-        load *= g_environmentSettings->m_currentValues.m_gravity;
+        double load = totalMass + fabs(torque) * settings.torqueScalingFactor;
+        load *= settings.gravity;
 
         //Determine the branch's strength.  If the branch's strength is not enough to hold the load, increase its width.
-        double strength = pow(m_width, g_simulationSettings->branchStrengthScalingPower) * g_simulationSettings->branchStrengthFactor;
+        double strength = pow(m_width, settings.branchStrengthScalingPower) * settings.branchStrengthFactor;
         if (load > strength)
-            m_width += g_simulationSettings->branchWidthGrowthIncrement;
+        {
+            m_width += settings.branchWidthGrowthIncrement;
+            widthChanged = true;
+        }
 
-        return;
+        return widthChanged;
     }
 
     else if (m_type == LEAF)
-        m_mass = getLength() * g_simulationSettings->leafDensity + 1.0;  //Add one to prevent zero-mass PlantParts
+        m_mass = getLength() * settings.leafDensity + 1.0;  //Add one to prevent zero-mass PlantParts
     else //SEEDPOD
-        m_mass = getLength() * g_simulationSettings->seedpodDensity + 1.0;  //Add one to prevent zero-mass PlantParts
+        m_mass = getLength() * settings.seedpodDensity + 1.0;  //Add one to prevent zero-mass PlantParts
     m_centreOfMass = Point2D((m_start.m_x + m_end.m_x) / 2.0, (m_start.m_y + m_end.m_y) / 2.0);
+    return false;
 }
 
 
@@ -592,73 +608,102 @@ void PlantPart::getShapesForDrawing(std::vector<QLineF> * branchLines,
 
 
 
-int PlantPart::getLeafCount() const
+//This adds the counts for this part and all parts above it.  Organisms keep
+//their counts up to date as they grow, so this is only needed when an
+//organism's counts have to be worked out from scratch, e.g. after loading.
+void PlantPart::addToPartCounts(int * branchCount, int * leafCount, int * seedpodCount,
+                                int * plantPartCount, int * growingPartCount) const
 {
-    if (m_type == LEAF)
-        return 1;
-    else if (m_type == BRANCH)
-    {
-        int leafCount = 0;
-        for (std::vector<PlantPart *>::const_iterator i = m_children.begin(); i != m_children.end(); ++i)
-            leafCount += (*i)->getLeafCount();
-        return leafCount;
-    }
-    else
-        return 0;
+    if (m_type == BRANCH)
+        ++(*branchCount);
+    else if (m_type == LEAF)
+        ++(*leafCount);
+    else if (m_type == SEEDPOD)
+        ++(*seedpodCount);
+    ++(*plantPartCount);
+    if (!m_finishedGrowing)
+        ++(*growingPartCount);
+
+    for (std::vector<PlantPart *>::const_iterator i = m_children.begin(); i != m_children.end(); ++i)
+        (*i)->addToPartCounts(branchCount, leafCount, seedpodCount, plantPartCount, growingPartCount);
 }
 
-int PlantPart::getBranchCount() const
+
+
+double PlantPart::getMassHereAndAbove() const
 {
     if (m_type == BRANCH)
     {
-        int branchCount = 1;
+        double mass = m_mass;
         for (std::vector<PlantPart *>::const_iterator i = m_children.begin(); i != m_children.end(); ++i)
-            branchCount += (*i)->getBranchCount();
-        return branchCount;
+            mass += (*i)->getMassHereAndAbove();
+        return mass;
     }
     else
-        return 0;
+        return getMass();
 }
 
-int PlantPart::getSeedpodCount() const
+
+
+void PlantPart::addToPreorderList(std::vector<PlantPart *> * parts)
 {
-    if (m_type == SEEDPOD)
-        return 1;
-    else if (m_type == BRANCH)
-    {
-        int seedpodCount = 0;
-        for (std::vector<PlantPart *>::const_iterator i = m_children.begin(); i != m_children.end(); ++i)
-            seedpodCount += (*i)->getSeedpodCount();
-        return seedpodCount;
-    }
-    else
-        return 0;
+    parts->push_back(this);
+    for (std::vector<PlantPart *>::const_iterator i = m_children.begin(); i != m_children.end(); ++i)
+        (*i)->addToPreorderList(parts);
 }
 
-int PlantPart::getPlantPartCount() const
+
+
+//This rebuilds a tree from its parts in preorder.  The stack holds each branch
+//whose children are still to come, along with how many it is still waiting on.
+//The child counts come from a file, so they are checked before any part is
+//linked, and an archive_exception is thrown if they don't make one tree.
+PlantPart * PlantPart::linkTree(const std::vector<PlantPart *> & parts, const std::vector<int> & childCounts,
+                                Organism * organism)
 {
-    if (m_type == BRANCH)
+    if (!isValidTree(childCounts))
+        throw boost::archive::archive_exception(boost::archive::archive_exception::input_stream_error);
+
+    std::vector<std::pair<PlantPart *, int> > openParts;
+    for (size_t i = 0; i < parts.size(); ++i)
     {
-        int partCount = 1;
-        for (std::vector<PlantPart *>::const_iterator i = m_children.begin(); i != m_children.end(); ++i)
-            partCount += (*i)->getPlantPartCount();
-        return partCount;
+        PlantPart * part = parts[i];
+        part->m_organism = organism;
+        part->m_parent = 0;
+        if (!openParts.empty())
+        {
+            part->m_parent = openParts.back().first;
+            part->m_parent->m_children.push_back(part);
+            if (--openParts.back().second == 0)
+                openParts.pop_back();
+        }
+        if (childCounts[i] > 0)
+        {
+            part->m_children.reserve(childCounts[i]);
+            openParts.push_back(std::pair<PlantPart *, int>(part, childCounts[i]));
+        }
     }
-    else
-        return 1;
+    return parts.empty() ? 0 : parts[0];
 }
 
-
-
-double PlantPart::getMassHereAndAbove() const
+//The counts make one tree if none is negative, every part after the first has
+//a parent still waiting on children, and no parent is left waiting at the end.
+bool PlantPart::isValidTree(const std::vector<int> & childCounts)
 {
-    if (m_type == BRANCH)
+    std::vector<int> openParts;
+    for (size_t i = 0; i < childCounts.size(); ++i)
     {
-        double mass = m_mass;
-        for (std::vector<PlantPart *>::const_iterator i = m_children.begin(); i != m_children.end(); ++i)
-            mass += (*i)->getMassHereAndAbove();
-        return mass;
+        if (childCounts[i] < 0)
+            return false;
+        if (i > 0)
+        {
+            if (openParts.empty())
+                return false;
+            if (--openParts.back() == 0)
+                openParts.pop_back();
+        }
+        if (childCounts[i] > 0)
+            openParts.push_back(childCounts[i]);
     }
-    else
-        return getMass();
+    return openParts.empty();
 }
@@ -33,25 +33,30 @@
 #include "boost/archive/text_iarchive.hpp"
 #include "boost/archive/text_oarchive.hpp"
 #include "boost/serialization/vector.hpp"
+#include "boost/archive/archive_exception.hpp"
 #endif // Q_MOC_RUN
 namespace boost {namespace serialization {class access;}}
 
 class Organism;
 class Seed;
+class RandomNumbers;
+class TickSettings;
 
 class PlantPart : boost::noncopyable
 {
 public:
     PlantPart() {}
-    PlantPart(Organism * organism, PlantPart * parent, int geneIndex, Point2D start);
+    PlantPart(Organism * organism, PlantPart * parent, int geneIndex, Point2D start,
+              const TickSettings & settings, RandomNumbers * randomNumbers);
     ~PlantPart();
 
-    void growOneTick();
-    void createChildParts();
-    void growChildParts();
-    void calculateCenterOfMass();
+    void growOneTick(const TickSettings & settings, RandomNumbers * randomNumbers);
+    void createChildParts(const TickSettings & settings, RandomNumbers * randomNumbers);
+    void growChildParts(const TickSettings & settings, RandomNumbers * randomNumbers);
+    bool calculateCenterOfMass(const TickSettings & settings);
     void receiveLight(double incomingLight);
-    void createSeeds(std::deque<Seed> * seeds, long long elapsedTime, bool dayTime, double seedProductionRate);
+    void createSeeds(std::vector<Seed> * seeds, long long elapsedTime, bool dayTime, double seedProductionRate,
+                     const TickSettings & settings, RandomNumbers * randomNumbers);
     void addLeavesToLightingVector(std::vector<PlantPart *> * leaves);
     void getShapesForDrawing(std::vector<QLineF> * branchLines,
                              std::vector<double> * branchWidths,
@@ -60,8 +65,8 @@ public:
                              std::vector<QRectF> * seedpodsEnds,
                              double environmentHeight,
                              bool ignoreVisibleArea) const;
-    double getGrowthCost();
-    double getMaintenanceCost() const;
+    double getGrowthCost(const TickSettings & settings);
+    double getMaintenanceCost(const TickSettings & settings) const;
     bool descendsFromGeneIndex(double otherGeneIndex) const;
     double getHighestPoint() const;
     double getHighestDrawnPoint(bool checkDescendants = true) const;
@@ -82,10 +87,55 @@ public:
     double getMassHereAndAbove() const;
     double getLength() const {return m_start.distanceTo(m_end);}
     bool getFinishedGrowing() const {return m_finishedGrowing;}
-    int getLeafCount() const;
-    int getBranchCount() const;
-    int getSeedpodCount() const;
-    int getPlantPartCount() const;
+    PlantPartType getType() const {return m_type;}
+    void addToPartCounts(int * branchCount, int * leafCount, int * seedpodCount,
+                         int * plantPartCount, int * growingPartCount) const;
+
+    //Plant part trees are archived as an array of part records in preorder,
+    //each followed by its number of children, instead of through pointers.
+    //This spares boost from tracking the address of every part, and the parent
+    //and organism pointers are set again in one pass when loading.  A null root
+    //is archived as a tree of no parts.
+    //Until a loaded tree is linked, its parts are only held in the list, so if
+    //the load fails they are deleted here.
+    template<typename Archive>
+    static void serializeTree(Archive & ar, PlantPart ** root, Organism * organism)
+    {
+        std::vector<PlantPart *> parts;
+        if (!Archive::is_loading::value && *root != 0)
+            (*root)->addToPreorderList(&parts);
+        int partCount = int(parts.size());
+        ar & partCount;
+        if (partCount < 0)
+            throw boost::archive::archive_exception(boost::archive::archive_exception::input_stream_error);
+
+        std::vector<int> childCounts(partCount, 0);
+        try
+        {
+            for (int i = 0; i < partCount; ++i)
+            {
+                if (Archive::is_loading::value)
+                    parts.push_back(new PlantPart());
+                else
+                    childCounts[i] = int(parts[i]->m_children.size());
+                parts[i]->serializeRecord(ar);
+                ar & childCounts[i];
+            }
+
+            if (Archive::is_loading::value)
+                *root = linkTree(parts, childCounts, organism);
+        }
+        catch (...)
+        {
+            if (Archive::is_loading::value)
+            {
+                for (size_t i = 0; i < parts.size(); ++i)
+                    delete parts[i];
+                *root = 0;
+            }
+            throw;
+        }
+    }
 
 private:
     Organism * m_organism;
@@ -104,10 +154,35 @@ private:
     double m_width; //Only used for Branches
     std::vector<PlantPart *> m_children; //Only used for Branches
 
-    AngleReference getAngleReference(int nucleotide);
     double distanceFromPointToLineSegment(const Point2D v, const Point2D w, const Point2D p) const;
-    void createOneChildPart(int childGeneIndex);
+    void finishGrowing();
+    template <bool allowLoops> void createChildParts(const TickSettings & settings, RandomNumbers * randomNumbers);
+    template <bool allowLoops> void createOneChildPart(int childGeneIndex, const TickSettings & settings,
+                                                       RandomNumbers * randomNumbers);
+    void addToPreorderList(std::vector<PlantPart *> * parts);
+    static PlantPart * linkTree(const std::vector<PlantPart *> & parts, const std::vector<int> & childCounts,
+                                Organism * organism);
+    static bool isValidTree(const std::vector<int> & childCounts);
+
+    template<typename Archive>
+    void serializeRecord(Archive & ar)
+    {
+        ar & m_type;
+        ar & m_start;
+        ar & m_end;
+        ar & m_geneIndex;
+        ar & m_dailyGrowth;
+        ar & m_angle;
+        ar & m_finalLength;
+        ar & m_finishedGrowing;
+        ar & m_centreOfMass;
+        ar & m_mass;
+        ar & m_previousLengthOrArea;
+        ar & m_width;
+    }
 
+    //This is only used to load files from before plant part trees were
+    //archived with serializeTree.
     friend class boost::serialization::access;
     template<typename Archive>
     void serialize(Archive & ar, const unsigned)
@@ -0,0 +1,334 @@
+//Copyright 2015 Ryan Wick
+
+//This file is part of Grovolve.
+
+//Grovolve is free software: you can redistribute it and/or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+
+//Grovolve is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with Grovolve.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "blockgzip.h"
+#include <stdint.h>
+#include <cstring>
+#include "tbb/parallel_for.h"
+#include "boost/crc.hpp"
+#include "boost/iostreams/filtering_stream.hpp"
+#include "boost/iostreams/filter/zlib.hpp"
+#include "boost/iostreams/device/array.hpp"
+#include "boost/iostreams/device/back_inserter.hpp"
+
+static void writeLittleEndian32(char * bytes, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i)
+        bytes[i] = char((value >> (8 * i)) & 0xff);
+}
+
+static uint32_t readLittleEndian32(const char * bytes)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i)
+        value |= uint32_t((unsigned char)bytes[i]) << (8 * i);
+    return value;
+}
+
+//The blocks are raw deflate streams inside gzip headers and trailers that are
+//written here, as boost's gzip_compressor can't add the extra field.
+static boost::iostreams::zlib_params getRawDeflateParams(int compressionLevel)
+{
+    return boost::iostreams::zlib_params(compressionLevel, boost::iostreams::zlib::deflated,
+                                         boost::iostreams::zlib::default_window_bits,
+                                         boost::iostreams::zlib::default_mem_level,
+                                         boost::iostreams::zlib::default_strategy, true);
+}
+
+static bool isBlockGzipHeader(const char * header)
+{
+    const unsigned char * bytes = reinterpret_cast<const unsigned char *>(header);
+    return bytes[0] == 31 && bytes[1] == 139 && bytes[2] == 8 && (bytes[3] & 4) != 0 &&
+            bytes[10] == 8 && bytes[11] == 0 && bytes[12] == 'G' && bytes[13] == 'V' &&
+            bytes[14] == 4 && bytes[15] == 0;
+}
+
+static void compressBlock(BlockGzipBlock * block, int compressionLevel)
+{
+    std::vector<char> & member = block->m_member;
+    member.clear();
+    member.resize(BLOCK_GZIP_HEADER_SIZE);
+    {
+        boost::iostreams::filtering_ostream out;
+        out.push(boost::iostreams::zlib_compressor(getRawDeflateParams(compressionLevel)));
+        out.push(boost::iostreams::back_inserter(member));
+        out.write(block->m_data.data(), block->m_size);
+    }
+
+    boost::crc_32_type crc;
+    crc.process_bytes(block->m_data.data(), block->m_size);
+    char trailer[BLOCK_GZIP_TRAILER_SIZE];
+    writeLittleEndian32(trailer, crc.checksum());
+    writeLittleEndian32(trailer + 4, uint32_t(block->m_size));
+    member.insert(member.end(), trailer, trailer + BLOCK_GZIP_TRAILER_SIZE);
+
+    //ID1, ID2, CM (deflate), FLG (FEXTRA), MTIME (none), XFL, OS (unknown),
+    //XLEN, then the GV subfield holding the member size.
+    const unsigned char header[16] = {31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 8, 0, 'G', 'V', 4, 0};
+    memcpy(member.data(), header, 16);
+    writeLittleEndian32(member.data() + 16, uint32_t(member.size()));
+}
+
+static bool decompressBlock(BlockGzipBlock * block)
+{
+    const std::vector<char> & member = block->m_member;
+    const char * trailer = member.data() + member.size() - BLOCK_GZIP_TRAILER_SIZE;
+    uint32_t crcFromFile = readLittleEndian32(trailer);
+    uint32_t size = readLittleEndian32(trailer + 4);
+    if (size > uint32_t(BLOCK_GZIP_BLOCK_SIZE))
+        return false;
+
+    block->m_data.resize(size);
+    block->m_size = size;
+    if (size == 0)
+        return true;
+
+    boost::iostreams::filtering_istream in;
+    in.push(boost::iostreams::zlib_decompressor(getRawDeflateParams(boost::iostreams::zlib::default_compression)));
+    in.push(boost::iostreams::array_source(member.data() + BLOCK_GZIP_HEADER_SIZE,
+                                           member.size() - BLOCK_GZIP_HEADER_SIZE - BLOCK_GZIP_TRAILER_SIZE));
+    in.read(block->m_data.data(), size);
+    if (in.gcount() != std::streamsize(size))
+        return false;
+
+    boost::crc_32_type crc;
+    crc.process_bytes(block->m_data.data(), size);
+    return crc.checksum() == crcFromFile;
+}
+
+
+
+
+BlockGzipOutputBuffer::BlockGzipOutputBuffer(std::ostream * out, int compressionLevel) :
+    m_out(out), m_compressionLevel(compressionLevel),
+    m_filling(BLOCK_GZIP_BATCH_SIZE), m_compressing(BLOCK_GZIP_BATCH_SIZE),
+    m_currentBlock(0), m_compressingCount(0), m_compression(new tbb::task_group()), m_finished(false)
+{
+    startBlock();
+}
+
+BlockGzipOutputBuffer::~BlockGzipOutputBuffer()
+{
+    finish();
+    delete m_compression;
+}
+
+
+//This compresses and writes whatever is left.  It is called by the destructor
+//if it hasn't been already.
+void BlockGzipOutputBuffer::finish()
+{
+    if (m_finished)
+        return;
+    m_finished = true;
+
+    endBlock();
+    writeCompressedBatch();
+    compressBatch(&m_filling, m_currentBlock);
+    for (size_t i = 0; i < m_currentBlock; ++i)
+    {
+        if (m_filling[i].m_size > 0)
+            m_out->write(m_filling[i].m_member.data(), m_filling[i].m_member.size());
+    }
+    m_out->flush();
+    setp(0, 0);
+}
+
+
+BlockGzipOutputBuffer::int_type BlockGzipOutputBuffer::overflow(int_type c)
+{
+    if (m_finished)
+        return traits_type::eof();
+
+    endBlock();
+    if (m_currentBlock == m_filling.size())
+    {
+        writeCompressedBatch();
+        std::swap(m_filling, m_compressing);
+        m_compressingCount = m_currentBlock;
+        size_t count = m_compressingCount;
+        m_compression->run([this, count] {compressBatch(&m_compressing, count);});
+        m_currentBlock = 0;
+    }
+    startBlock();
+
+    if (!traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+
+void BlockGzipOutputBuffer::startBlock()
+{
+    std::vector<char> & data = m_filling[m_currentBlock].m_data;
+    data.resize(BLOCK_GZIP_BLOCK_SIZE);
+    setp(data.data(), data.data() + BLOCK_GZIP_BLOCK_SIZE);
+}
+
+void BlockGzipOutputBuffer::endBlock()
+{
+    m_filling[m_currentBlock].m_size = pptr() - pbase();
+    ++m_currentBlock;
+}
+
+
+//This waits for the batch being compressed in the background and writes it.
+void BlockGzipOutputBuffer::writeCompressedBatch()
+{
+    m_compression->wait();
+    for (size_t i = 0; i < m_compressingCount; ++i)
+        m_out->write(m_compressing[i].m_member.data(), m_compressing[i].m_member.size());
+    m_compressingCount = 0;
+}
+
+
+void BlockGzipOutputBuffer::compressBatch(std::vector<BlockGzipBlock> * batch, size_t count) const
+{
+    int compressionLevel = m_compressionLevel;
+    tbb::parallel_for(size_t(0), count, [batch, compressionLevel](size_t i)
+    {
+        compressBlock(&(*batch)[i], compressionLevel);
+    });
+}
+
+
+
+
+BlockGzipInputBuffer::BlockGzipInputBuffer(std::istream * in, std::streamoff length) :
+    m_in(in), m_remaining(length), m_reading(BLOCK_GZIP_BATCH_SIZE), m_decompressing(BLOCK_GZIP_BATCH_SIZE),
+    m_readingCount(0), m_decompressingCount(0), m_currentBlock(0),
+    m_decompression(new tbb::task_group()), m_started(false)
+{
+}
+
+BlockGzipInputBuffer::~BlockGzipInputBuffer()
+{
+    m_decompression->wait();
+    delete m_decompression;
+}
+
+
+//This returns the size of the first block in the stream, or 0 if the stream
+//doesn't start with one.  The stream is then put back to the start.
+std::streamoff BlockGzipInputBuffer::getFirstBlockSize(std::istream * in)
+{
+    char header[BLOCK_GZIP_HEADER_SIZE];
+    std::streamoff size = 0;
+    if (in->read(header, BLOCK_GZIP_HEADER_SIZE) && isBlockGzipHeader(header))
+        size = readLittleEndian32(header + 16);
+    in->clear();
+    in->seekg(0);
+    return size;
+}
+
+
+BlockGzipInputBuffer::int_type BlockGzipInputBuffer::underflow()
+{
+    if (gptr() < egptr())
+        return traits_type::to_int_type(*gptr());
+
+    while (true)
+    {
+        if (m_currentBlock == m_readingCount)
+        {
+            if (!m_started)
+            {
+                m_started = true;
+                startNextBatch();
+            }
+            m_decompression->wait();
+            std::swap(m_reading, m_decompressing);
+            m_readingCount = m_decompressingCount;
+            m_decompressingCount = 0;
+            m_currentBlock = 0;
+            if (m_readingCount == 0)
+            {
+                setg(0, 0, 0);
+                return traits_type::eof();
+            }
+            startNextBatch();
+        }
+
+        BlockGzipBlock & block = m_reading[m_currentBlock++];
+        if (block.m_size > 0)
+        {
+            setg(block.m_data.data(), block.m_data.data(), block.m_data.data() + block.m_size);
+            return traits_type::to_int_type(*gptr());
+        }
+    }
+}
+
+
+void BlockGzipInputBuffer::startNextBatch()
+{
+    m_decompression->run([this] {m_decompressingCount = readAndDecompressBatch(&m_decompressing);});
+}
+
+
+//The blocks are read from the file one after the other, as the size of each is
+//in its header, and then decompressed in parallel.  If a block is damaged, the
+//data ends before it.
+size_t BlockGzipInputBuffer::readAndDecompressBatch(std::vector<BlockGzipBlock> * batch)
+{
+    size_t count = 0;
+    while (count < batch->size() && readMember(&(*batch)[count]))
+        ++count;
+
+    std::vector<char> decompressed(count, 0);
+    tbb::parallel_for(size_t(0), count, [batch, &decompressed](size_t i)
+    {
+        decompressed[i] = decompressBlock(&(*batch)[i]);
+    });
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (!decompressed[i])
+        {
+            m_in->setstate(std::ios_base::failbit);
+            return i;
+        }
+    }
+    return count;
+}
+
+
+bool BlockGzipInputBuffer::readMember(BlockGzipBlock * block)
+{
+    char header[BLOCK_GZIP_HEADER_SIZE];
+    if (m_remaining == 0 || !m_in->read(header, BLOCK_GZIP_HEADER_SIZE) || !isBlockGzipHeader(header))
+        return false;
+
+    uint32_t memberSize = readLittleEndian32(header + 16);
+    if (memberSize < uint32_t(BLOCK_GZIP_HEADER_SIZE + BLOCK_GZIP_TRAILER_SIZE) ||
+            memberSize > uint32_t(2 * BLOCK_GZIP_BLOCK_SIZE))
+        return false;
+    if (m_remaining > 0)
+    {
+        if (memberSize > m_remaining)
+            return false;
+        m_remaining -= memberSize;
+    }
+
+    std::vector<char> & member = block->m_member;
+    member.resize(memberSize);
+    memcpy(member.data(), header, BLOCK_GZIP_HEADER_SIZE);
+    return bool(m_in->read(member.data() + BLOCK_GZIP_HEADER_SIZE, memberSize - BLOCK_GZIP_HEADER_SIZE));
+}
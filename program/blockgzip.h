@@ -0,0 +1,115 @@
+//Copyright 2015 Ryan Wick
+
+//This file is part of Grovolve.
+
+//Grovolve is free software: you can redistribute it and/or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+
+//Grovolve is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with Grovolve.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef BLOCKGZIP_H
+#define BLOCKGZIP_H
+
+#include <streambuf>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#ifndef Q_MOC_RUN
+#include "tbb/task_group.h"
+#endif // Q_MOC_RUN
+
+//Save files are compressed as a series of blocks, each a complete gzip member
+//holding up to BLOCK_GZIP_BLOCK_SIZE bytes of data.  Since the blocks are
+//independent, a batch of them can be compressed or decompressed at once on all
+//cores.  A file of several gzip members is still a valid gzip file, so save
+//files can be read with gzip/zcat as before.
+//Each member's header has an extra field (subfield ID "GV") giving the size of
+//the whole member, so a reader can find where each block starts without
+//decompressing anything.  The gzip header of a block is always 20 bytes.
+const int BLOCK_GZIP_BLOCK_SIZE = 1 << 20;
+const int BLOCK_GZIP_BATCH_SIZE = 16;
+const int BLOCK_GZIP_HEADER_SIZE = 20;
+const int BLOCK_GZIP_TRAILER_SIZE = 8;
+
+struct BlockGzipBlock
+{
+    BlockGzipBlock() : m_size(0) {}
+    std::vector<char> m_data;
+    size_t m_size;
+    std::vector<char> m_member;
+};
+
+
+//Data written to this buffer is split into blocks which are compressed a batch
+//at a time.  Each batch is compressed in the background while the next one is
+//being filled.  finish must be called after the last write.
+class BlockGzipOutputBuffer : public std::streambuf
+{
+public:
+    BlockGzipOutputBuffer(std::ostream * out, int compressionLevel);
+    ~BlockGzipOutputBuffer();
+
+    void finish();
+
+protected:
+    int_type overflow(int_type c);
+
+private:
+    std::ostream * m_out;
+    int m_compressionLevel;
+    std::vector<BlockGzipBlock> m_filling;
+    std::vector<BlockGzipBlock> m_compressing;
+    size_t m_currentBlock;
+    size_t m_compressingCount;
+    tbb::task_group * m_compression;
+    bool m_finished;
+
+    void startBlock();
+    void endBlock();
+    void writeCompressedBatch();
+    void compressBatch(std::vector<BlockGzipBlock> * batch, size_t count) const;
+};
+
+
+//This reads a file written by BlockGzipOutputBuffer.  While one batch of
+//blocks is being read from, the next is read and decompressed in the
+//background.  If a length is given, only the blocks in that many bytes from
+//the stream's current position are read.
+class BlockGzipInputBuffer : public std::streambuf
+{
+public:
+    BlockGzipInputBuffer(std::istream * in, std::streamoff length = -1);
+    ~BlockGzipInputBuffer();
+
+    static std::streamoff getFirstBlockSize(std::istream * in);
+
+protected:
+    int_type underflow();
+
+private:
+    std::istream * m_in;
+    std::streamoff m_remaining;
+    std::vector<BlockGzipBlock> m_reading;
+    std::vector<BlockGzipBlock> m_decompressing;
+    size_t m_readingCount;
+    size_t m_decompressingCount;
+    size_t m_currentBlock;
+    tbb::task_group * m_decompression;
+    bool m_started;
+
+    void startNextBatch();
+    size_t readAndDecompressBatch(std::vector<BlockGzipBlock> * batch);
+    bool readMember(BlockGzipBlock * block);
+};
+
+#endif // BLOCKGZIP_H
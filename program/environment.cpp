@@ -20,18 +20,22 @@
 #include <math.h>
 #include <algorithm>    // std::sort
 #include <vector>
-#include <map>
 #include "randomnumbers.h"
 #include "../plant/plantpart.h"
 #include "../plant/genome.h"
 #include "../plant/seed.h"
 #include "stats.h"
 #include "../settings/environmentsettings.h"
+#include "../settings/ticksettings.h"
+#include "tbb/parallel_for.h"
+#include "tbb/task_group.h"
 
 Environment::Environment() :
     m_width(g_simulationSettings->startingEnvironmentWidth), m_height(g_simulationSettings->startingEnvironmentHeight),
-    m_elapsedTime(0), m_numberOfNullSeeds(0), m_elapsedRealWorldSeconds(0.0)
+    m_elapsedTime(0), m_numberOfNullSeeds(0), m_elapsedRealWorldSeconds(0.0),
+    m_organismsUntilUnluckyDeath(0), m_unluckyDeathRate(-1.0), m_previousTickSettings(0)
 {
+    clearPopulationTotals();
     reset();
 }
 
@@ -39,6 +43,7 @@ Environment::Environment() :
 Environment::~Environment()
 {
     cleanUp();
+    delete m_previousTickSettings;
 }
 
 
@@ -48,6 +53,7 @@ void Environment::cleanUp()
         delete *i;
     m_organisms.clear();
     m_seeds.clear();
+    clearPopulationTotals();
 }
 
 
@@ -61,13 +67,16 @@ void Environment::reset()
     m_width = g_simulationSettings->startingEnvironmentWidth;
     g_lighting->resetSunIntensity();
 
+    TickSettings settings;
     for (int i = 0; i < g_simulationSettings->targetPopulationSize; ++i)
     {
         m_organisms.push_back(new Organism(g_simulationSettings->startingOrganismEnergy,
                                            m_elapsedTime,
-                                           g_randomNumbers->getRandomDouble(0.0, m_width)));
+                                           g_randomNumbers->getRandomDouble(0.0, m_width),
+                                           settings));
         ++(g_stats->m_numberOfOrganismsSprouted);
     }
+    recalculatePopulationTotals();
 
     logStats();
 }
@@ -78,36 +87,118 @@ void Environment::resetTime()
     m_elapsedTime = 0;
     m_elapsedRealWorldSeconds = 0.0;
     setDateAndTimeOfSimStart();
-    m_logIntervalMultiplier = 1;
 }
 
 
 void Environment::advanceOneTick()
 {
-    for (std::list<Organism *>::iterator i = m_organisms.begin(); i != m_organisms.end(); ++i)
-    {
-        (*i)->growOneTick();
-        (*i)->transmitLoadAndGrowWidthOneTick();
-        (*i)->useEnergyOneTick();
-    }
+    TickSettings settings(m_previousTickSettings);
+    delete m_previousTickSettings;
+    m_previousTickSettings = new TickSettings(settings);
 
-    killOffStarvedAndUnluckyOrganisms();
-    getRidOfOldSeeds();
+    if (isDaytime())
+        advanceOneDayTick(settings);
+    else
+        advanceOneNightTick(settings);
 
-    for (std::list<Organism *>::iterator i = m_organisms.begin(); i != m_organisms.end(); ++i)
-        (*i)->createSeeds(&m_seeds, m_elapsedTime, isDaytime());
+    if (m_elapsedTime % getLogInterval() == 0)
+        logStats();
+}
+
+
+//The tick's steps depend on each other as follows:
+//  growth (parallel over blocks of organisms) and seed expiry run at the same time
+//  -> deaths -> seed creation (parallel) -> germination -> lighting (parallel)
+//  -> energy limit.
+//Deaths and germination draw from the main random number generator, so they
+//stay serial and in this order to keep the simulation deterministic.
+void Environment::advanceOneDayTick(const TickSettings & settings)
+{
+    tbb::task_group seedExpiry;
+    seedExpiry.run([&]{getRidOfOldSeeds();});
+    growOrganisms(settings, false);
+    seedExpiry.wait();
 
-    createNewOrganisms();
+    killOffStarvedAndUnluckyOrganisms();
+
+    createSeeds(settings);
+    createNewOrganisms(settings);
     ++m_elapsedTime;
     distributeLightToLeaves();
     limitPlantEnergyToMaximum();
+}
 
-    if (m_elapsedTime % getLogInterval() == 0)
-        logStats();
+
+//At night, organisms can't make seeds or receive light, so a night tick only
+//does growth, maintenance, deaths and germination.  Organisms that are settled
+//(see Organism::advanceOneNightTick) skip growth and use a cached maintenance
+//cost.  Energy only goes down at night while mass only goes up, so the energy
+//limit only needs to be applied to new organisms.
+//Skipping seed creation also skips the random seeds it would draw for its
+//blocks, so the random number sequence (and so the simulation) is not the same
+//as it would be if night ticks ran the day tick's steps.
+void Environment::advanceOneNightTick(const TickSettings & settings)
+{
+    tbb::task_group seedExpiry;
+    seedExpiry.run([&]{getRidOfOldSeeds();});
+    growOrganisms(settings, true);
+    seedExpiry.wait();
+
+    killOffStarvedAndUnluckyOrganisms();
+
+    size_t oldOrganismCount = m_organisms.size();
+    createNewOrganisms(settings);
+    ++m_elapsedTime;
+
+    //The lighting is still told that the sun is down, as the display uses it.
+    std::vector<PlantPart *> noLeaves;
+    g_lighting->distributeLight(&noLeaves, this, 0.0, 0.0);
+
+    std::list<Organism *>::iterator firstNewOrganism = m_organisms.begin();
+    std::advance(firstNewOrganism, oldOrganismCount);
+    limitPlantEnergyToMaximum(firstNewOrganism);
 }
 
 
 
+//Organisms are grown in parallel over fixed-size blocks.  Growth only needs
+//random numbers when it makes new plant parts, so each block has its own
+//generator, seeded in order from the main one.
+void Environment::growOrganisms(const TickSettings & settings, bool nightTick)
+{
+    std::vector<Organism *> organisms(m_organisms.begin(), m_organisms.end());
+    size_t blockSize = g_simulationSettings->organismsPerTask;
+    size_t blockCount = (organisms.size() + blockSize - 1) / blockSize;
+
+    std::vector<unsigned int> randomSeeds;
+    for (size_t i = 0; i < blockCount; ++i)
+        randomSeeds.push_back(g_randomNumbers->getRandomSeed());
+
+    bool firstTickOfNight = getDayProgression() == g_simulationSettings->dayLength;
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, blockCount),
+                      [&](const tbb::blocked_range<size_t>& r)
+    {
+        for (size_t block = r.begin(); block != r.end(); ++block)
+        {
+            RandomNumbers randomNumbers(randomSeeds[block]);
+            size_t blockEnd = std::min((block + 1) * blockSize, organisms.size());
+            for (size_t i = block * blockSize; i < blockEnd; ++i)
+            {
+                if (nightTick)
+                    organisms[i]->advanceOneNightTick(settings, firstTickOfNight, &randomNumbers);
+                else
+                {
+                    organisms[i]->growOneTick(settings, &randomNumbers);
+                    organisms[i]->transmitLoadAndGrowWidthOneTick(settings);
+                    organisms[i]->useEnergyOneTick(settings);
+                }
+            }
+        }
+    }
+    );
+}
+
+
 void Environment::distributeLightToLeaves()
 {
     std::vector<PlantPart *> leaves;
@@ -117,15 +208,27 @@ void Environment::distributeLightToLeaves()
 
 void Environment::limitPlantEnergyToMaximum()
 {
-    for (std::list<Organism *>::iterator i = m_organisms.begin(); i != m_organisms.end(); ++i)
+    limitPlantEnergyToMaximum(m_organisms.begin());
+}
+
+//Each organism is limited independently, so this is done in parallel.
+void Environment::limitPlantEnergyToMaximum(std::list<Organism *>::iterator firstOrganism)
+{
+    std::vector<Organism *> organisms(firstOrganism, m_organisms.end());
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, organisms.size()),
+                      [&](const tbb::blocked_range<size_t>& r)
     {
-        //TEMPORARILY JUST USING MASS PLUS 1000 AS THE MAX ENERGY
-        double maximumPlantEnergy = 1000.0 + (*i)->getMass();
-        double plantEnergy = (*i)->getEnergy();
+        for (size_t i = r.begin(); i != r.end(); ++i)
+        {
+            //TEMPORARILY JUST USING MASS PLUS 1000 AS THE MAX ENERGY
+            double maximumPlantEnergy = 1000.0 + organisms[i]->getMass();
+            double plantEnergy = organisms[i]->getEnergy();
 
-        if (plantEnergy > maximumPlantEnergy)
-            (*i)->setEnergy(maximumPlantEnergy);
+            if (plantEnergy > maximumPlantEnergy)
+                organisms[i]->setEnergy(maximumPlantEnergy);
+        }
     }
+    );
 }
 
 
@@ -186,29 +289,57 @@ void Environment::killOffStarvedAndUnluckyOrganisms()
         //Kill starved organisms
         if ((*i)->getEnergy() < 0.0)
         {
+            removeFromPopulationTotals(*i);
             delete *i;
             i = m_organisms.erase(i);
             ++(g_stats->m_numberOfOrganismsDiedFromStarvation);
         }
 
         //Kill unlucky organisms
-        else if (g_randomNumbers->chanceOfTrue(g_simulationSettings->randomDeathRate))
+        else if (nextOrganismIsUnlucky())
         {
             //Helped organisms have a lower chance of death.
             if (!(*i)->isHelped() ||
                     g_randomNumbers->chanceOfTrue(g_simulationSettings->helpedDeathRate))
             {
+                removeFromPopulationTotals(*i);
                 delete *i;
                 i = m_organisms.erase(i);
                 ++(g_stats->m_numberOfOrganismsDiedFromBadLuck);
             }
         }
         else
+        {
+            updateGrownTotals(*i);
             ++i;
+        }
     }
 }
 
 
+//Each check of a non-starved organism is an independent trial with a chance of
+//randomDeathRate.  Instead of drawing a random number for every check, the
+//number of checks until the next unlucky organism is drawn from a geometric
+//distribution, and it carries over from one tick to the next.
+bool Environment::nextOrganismIsUnlucky()
+{
+    if (m_unluckyDeathRate != g_simulationSettings->randomDeathRate)
+    {
+        m_unluckyDeathRate = g_simulationSettings->randomDeathRate;
+        m_organismsUntilUnluckyDeath = g_randomNumbers->getTrialsBeforeSuccess(m_unluckyDeathRate);
+    }
+
+    if (m_organismsUntilUnluckyDeath > 0)
+    {
+        --m_organismsUntilUnluckyDeath;
+        return false;
+    }
+
+    m_organismsUntilUnluckyDeath = g_randomNumbers->getTrialsBeforeSuccess(m_unluckyDeathRate);
+    return true;
+}
+
+
 void Environment::getRidOfOldSeeds()
 {
     //Since Seeds will be naturally sorted by age (as they all always pushed
@@ -221,21 +352,73 @@ void Environment::getRidOfOldSeeds()
     {
         if (m_seeds.front().isNull())
             --m_numberOfNullSeeds;
+        else
+            m_totalSeedEnergy -= m_seeds.front().getEnergy();
         m_seeds.pop_front();
     }
+
+    //Whenever the seeds run out, the total is set to exactly zero so rounding
+    //errors can't build up.
+    if (getSeedCount() == 0)
+        m_totalSeedEnergy = 0.0;
+}
+
+
+
+//Seeds are made in parallel over fixed-size blocks of organisms.  Each block has
+//its own random number generator and seed buffer, and the buffers are added to
+//the seed bank in block order, so the result doesn't depend on threading.
+void Environment::createSeeds(const TickSettings & settings)
+{
+    std::vector<Organism *> organisms(m_organisms.begin(), m_organisms.end());
+    size_t blockSize = g_simulationSettings->organismsPerTask;
+    size_t blockCount = (organisms.size() + blockSize - 1) / blockSize;
+
+    std::vector<unsigned int> randomSeeds;
+    for (size_t i = 0; i < blockCount; ++i)
+        randomSeeds.push_back(g_randomNumbers->getRandomSeed());
+
+    bool dayTime = isDaytime();
+    std::vector<std::vector<Seed> > newSeeds(blockCount);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, blockCount),
+                      [&](const tbb::blocked_range<size_t>& r)
+    {
+        for (size_t block = r.begin(); block != r.end(); ++block)
+        {
+            RandomNumbers randomNumbers(randomSeeds[block]);
+            size_t blockEnd = std::min((block + 1) * blockSize, organisms.size());
+            for (size_t i = block * blockSize; i < blockEnd; ++i)
+                organisms[i]->createSeeds(&newSeeds[block], m_elapsedTime, dayTime, settings, &randomNumbers);
+        }
+    }
+    );
+
+    for (std::vector<std::vector<Seed> >::const_iterator i = newSeeds.begin(); i != newSeeds.end(); ++i)
+    {
+        m_seeds.insert(m_seeds.end(), i->begin(), i->end());
+        g_stats->m_numberOfSeedsGenerated += i->size();
+        for (std::vector<Seed>::const_iterator j = i->begin(); j != i->end(); ++j)
+            m_totalSeedEnergy += j->getEnergy();
+    }
 }
 
 
 
-void Environment::createNewOrganisms()
+void Environment::createNewOrganisms(const TickSettings & settings)
 {
     int newOrganismCount = g_randomNumbers->changeDoubleToProbabilisticInt(g_simulationSettings->newOrganismsPerTickPerSeed * m_seeds.size());
 
+    //First choose the parent Seeds, the position and a random number seed for
+    //each new organism.  This is done serially with the main random number
+    //generator so the outcome doesn't depend on how the work is threaded.
+    std::vector<Seed> parentSeeds;
+    std::vector<double> positions;
+    std::vector<unsigned int> randomSeeds;
     for (int i = 0; i < newOrganismCount; ++i)
     {
-        //If there are less than 2, then nothing can be done, so quit the function.
+        //If there are less than 2, then nothing more can be done.
         if (getSeedCount() < 2)
-            return;
+            break;
 
         //Choose two random seeds.
         int seedIndex1, seedIndex2;
@@ -248,20 +431,42 @@ void Environment::createNewOrganisms()
             seedIndex2 = g_randomNumbers->getRandomInt(0, int(m_seeds.size()) - 1);
         } while (m_seeds[seedIndex2].isNull() || seedIndex1 == seedIndex2);
 
-        //Create an organism from the two Seeds.
-        m_organisms.push_back(new Organism(m_seeds[seedIndex1], m_seeds[seedIndex2],
-                                           m_elapsedTime,
-                                           g_randomNumbers->getRandomDouble(0.0, m_width)));
+        parentSeeds.push_back(m_seeds[seedIndex1]);
+        parentSeeds.push_back(m_seeds[seedIndex2]);
+        positions.push_back(g_randomNumbers->getRandomDouble(0.0, m_width));
+        randomSeeds.push_back(g_randomNumbers->getRandomSeed());
 
         ++(g_stats->m_numberOfOrganismsSprouted);
 
         //Delete the two Seeds.  They are just labelled as null as actually removing
         //them from the middle of the deque is a costly procedure.
+        m_totalSeedEnergy -= m_seeds[seedIndex1].getEnergy() + m_seeds[seedIndex2].getEnergy();
         m_seeds[seedIndex1].makeNull();
         m_seeds[seedIndex2].makeNull();
 
         m_numberOfNullSeeds += 2;
     }
+    if (getSeedCount() == 0)
+        m_totalSeedEnergy = 0.0;
+
+    //Now create the organisms in parallel.  Each one gets its own random number
+    //generator and they are added to the population in the order chosen above.
+    //Done in parallel using Intel Threading Building Blocks.
+    std::vector<Organism *> newOrganisms(positions.size());
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, newOrganisms.size()),
+                      [&](const tbb::blocked_range<size_t>& r)
+    {
+        for (size_t i = r.begin(); i != r.end(); ++i)
+        {
+            RandomNumbers randomNumbers(randomSeeds[i]);
+            newOrganisms[i] = new Organism(parentSeeds[2 * i], parentSeeds[2 * i + 1],
+                                           m_elapsedTime, positions[i], settings, &randomNumbers);
+        }
+    }
+    );
+    m_organisms.insert(m_organisms.end(), newOrganisms.begin(), newOrganisms.end());
+    for (std::vector<Organism *>::const_iterator i = newOrganisms.begin(); i != newOrganisms.end(); ++i)
+        addToPopulationTotals(*i);
 }
 
 
@@ -269,12 +474,6 @@ void Environment::createNewOrganisms()
 
 void Environment::logStats()
 {
-    if (int(g_stats->m_time.size()) >= g_simulationSettings->maxLogEntries &&
-            g_stats->m_time.size() % 2 == 0)
-    {
-        g_stats->deleteHalfOfAllData();
-        m_logIntervalMultiplier *= 2;
-    }
     g_stats->addToLog(this);
 }
 
@@ -330,15 +529,7 @@ double Environment::getHeaviestPlantMass() const
 
 int Environment::getFullyGrownPlantCount() const
 {
-    int fullyGrownPlantCount = 0;
-
-    for (std::list<Organism *>::const_iterator i = m_organisms.begin(); i != m_organisms.end(); ++i)
-    {
-        if ((*i)->isFinishedGrowing())
-            ++fullyGrownPlantCount;
-    }
-
-    return fullyGrownPlantCount;
+    return m_fullyGrownPlantCount;
 }
 
 
@@ -425,7 +616,7 @@ void Environment::getPercentilesOfDoubleVector(std::vector<double> * doubleVecto
                                                double * ninetyNinthPercentile,
                                                double * ninetyFifthPercentile,
                                                double * ninetiethPercentile,
-                                               double * median) const
+                                               double * median)
 {
     size_t n = doubleVector->size();
 
@@ -449,7 +640,30 @@ void Environment::getPercentilesOfDoubleVector(std::vector<double> * doubleVecto
         return;
     }
 
-    std::sort(doubleVector->begin(), doubleVector->end());
+    //Only the elements that the percentiles are read from need to be in their
+    //sorted positions, so those are selected instead of sorting everything.
+    //Selecting from the highest position down lets each selection work on
+    //only the part of the vector below the previous one.
+    const double percentiles[4] = {0.99, 0.95, 0.9, 0.5};
+    std::vector<int> positions;
+    positions.push_back(int(n) - 1);
+    for (int i = 0; i < 4; ++i)
+    {
+        int index = getPercentileIndex(n, percentiles[i]);
+        if (index >= 0)
+            positions.push_back(index);
+        positions.push_back(std::min(index + 1, int(n) - 1));
+    }
+    std::sort(positions.begin(), positions.end());
+    positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+
+    std::vector<double>::iterator end = doubleVector->end();
+    for (std::vector<int>::reverse_iterator i = positions.rbegin(); i != positions.rend(); ++i)
+    {
+        std::vector<double>::iterator position = doubleVector->begin() + *i;
+        std::nth_element(doubleVector->begin(), position, end);
+        end = position;
+    }
 
     *max = (*doubleVector)[n-1];
     *ninetyNinthPercentile = getPercentile(doubleVector, 0.99);
@@ -459,27 +673,39 @@ void Environment::getPercentilesOfDoubleVector(std::vector<double> * doubleVecto
 }
 
 
-//This function gets a percentile.  It assumes that sortedDoubleVector has at least two elements.
-//TODO: I need to verify that this function won't crash, as long as the assumption is met.
-double Environment::getPercentile(std::vector<double> * sortedDoubleVector, double percentile) const
+//This function gets a percentile.  It assumes that doubleVector has at least
+//two elements and that the ones at the percentile's positions (see
+//getPercentileIndex) are where they would be if it were sorted.
+double Environment::getPercentile(const std::vector<double> * doubleVector, double percentile)
 {
-    double rank = (sortedDoubleVector->size() + 1.0) * percentile;
+    double rank = (doubleVector->size() + 1.0) * percentile;
 
     //Break the rank into integral and fractional parts
     double intRank;
     double fractionalRank = modf(rank, &intRank);
 
     double val1;
-    int index = int(intRank) - 1;
+    int index = getPercentileIndex(doubleVector->size(), percentile);
     if (index < 0)
         val1 = 0;
     else
-        val1 = (*sortedDoubleVector)[index];
-    double val2 = (*sortedDoubleVector)[index + 1];
+        val1 = (*doubleVector)[index];
+
+    //For small vectors, the rank of a high percentile can be past the last
+    //element, in which case the last element is used.
+    double val2 = (*doubleVector)[std::min(index + 1, int(doubleVector->size()) - 1)];
 
     return val1 + fractionalRank * (val2 - val1);
 }
 
+//The percentile is interpolated between the elements at this index and the
+//next one.
+int Environment::getPercentileIndex(size_t n, double percentile)
+{
+    double rank = (n + 1.0) * percentile;
+    return int(floor(rank)) - 1;
+}
+
 
 
 
@@ -552,57 +778,40 @@ Organism * Environment::findOrganismUnderPoint(Point2D point) const
 
 double Environment::getAverageEnergyPerSeed() const
 {
-    int seedCount = 0;
-    double totalSeedEnergy = 0.0;
-
-    for (std::deque<Seed>::const_iterator i = m_seeds.begin(); i != m_seeds.end(); ++i)
-    {
-        if (i->isNotNull())
-        {
-            ++seedCount;
-            totalSeedEnergy += i->getEnergy();
-        }
-    }
-
-    if (seedCount == 0)
+    if (getSeedCount() == 0)
         return 0.0;
 
-    return totalSeedEnergy / m_seeds.size();
+    return m_totalSeedEnergy / m_seeds.size();
 }
 
 
 //This function calculates the mean number of plant parts (of the given type)
-//for the fraction of the population that has reached the non-starved age.
+//for the organisms that have finished growing.
 double Environment::getMeanPartsPerPlant(PlantPartType partType) const
 {
-    int totalParts = 0;
-
-    std::vector<const Organism *> grownOrganisms = getGrownOrganisms();
-    if (grownOrganisms.size() == 0)
+    if (m_fullyGrownPlantCount == 0)
         return 0.0;
 
-    for (std::vector<const Organism *>::const_iterator i = grownOrganisms.begin(); i != grownOrganisms.end(); ++i)
+    int totalParts = 0;
+    switch (partType)
     {
-        switch (partType)
-        {
-        case BRANCH:
-            totalParts += (*i)->getBranchCount();
-            break;
-        case LEAF:
-            totalParts += (*i)->getLeafCount();
-            break;
-        case SEEDPOD:
-            totalParts += (*i)->getSeedpodCount();
-            break;
-        case ANY_PART:
-            totalParts += (*i)->getPlantPartCount();
-            break;
-        case NO_PART:
-            break;
-        }
+    case BRANCH:
+        totalParts = m_grownBranchCount;
+        break;
+    case LEAF:
+        totalParts = m_grownLeafCount;
+        break;
+    case SEEDPOD:
+        totalParts = m_grownSeedpodCount;
+        break;
+    case ANY_PART:
+        totalParts = m_grownPlantPartCount;
+        break;
+    case NO_PART:
+        break;
     }
 
-    return double(totalParts) / grownOrganisms.size();
+    return double(totalParts) / m_fullyGrownPlantCount;
 }
 
 
@@ -612,67 +821,89 @@ double Environment::getMeanPartsPerPlant(PlantPartType partType) const
 // -The gene at each position is equal to the most common gene at that position in the current population.
 //It therefore serves to capture the 'standard' genome for the current population, even though
 //it is quite possible (likely?) that the genome it returns is not exactly represented in any organism.
+//It is read from the nucleotide counts, so it only takes time in proportion to the genome length.
 Genome Environment::getModeGenome() const
 {
-    std::vector<Genome *> allGenomes;
-    for (std::list<Organism *>::const_iterator i = m_organisms.begin(); i != m_organisms.end(); ++i)
-        allGenomes.push_back((*i)->getGenome());
-
-    std::vector<int> genomeLengths;
-    for (std::vector<Genome *>::iterator i = allGenomes.begin(); i != allGenomes.end(); ++i)
-        genomeLengths.push_back(int((*i)->getGenomeLength()));
-
-    int modeGenomeLength = getMode(&genomeLengths);
+    int modeGenomeLength = getModeGenomeLength();
     Genome modeGenome;
-
-    std::vector<int> genesAtOnePosition;
     for (int i = 0; i < modeGenomeLength; ++i)
+        modeGenome.addNucleotide(getNucleotideMode(&m_nucleotideCounts[4 * i]));
+    return modeGenome;
+}
+
+
+//If more than one length is the most common, the shortest is returned.
+int Environment::getModeGenomeLength() const
+{
+    int modeGenomeLength = 0;
+    int highestFrequency = 0;
+    for (size_t i = 0; i < m_genomeLengthCounts.size(); ++i)
     {
-        genesAtOnePosition.clear();
-        for (std::vector<Genome *>::iterator j = allGenomes.begin(); j != allGenomes.end(); ++j)
+        if (m_genomeLengthCounts[i] > highestFrequency)
         {
-            if (i < (*j)->getGenomeLength())
-                genesAtOnePosition.push_back((*j)->getNucleotide(i));
+            modeGenomeLength = int(i);
+            highestFrequency = m_genomeLengthCounts[i];
         }
-        modeGenome.addNucleotide(getMode(&genesAtOnePosition));
     }
-
-    return modeGenome;
+    return modeGenomeLength;
 }
 
 
+//This gives the Shannon entropy, in bits, of the nucleotides at one genome
+//position across the organisms whose genomes reach that position.  It is 0
+//when they all share a nucleotide and 2 when all four are equally common.
+double Environment::getNucleotideEntropy(int position) const
+{
+    if (4 * position + 3 >= int(m_nucleotideCounts.size()))
+        return 0.0;
 
+    const int * counts = &m_nucleotideCounts[4 * position];
+    int total = counts[0] + counts[1] + counts[2] + counts[3];
+    if (total == 0)
+        return 0.0;
 
+    double entropy = 0.0;
+    for (int i = 0; i < 4; ++i)
+    {
+        if (counts[i] > 0)
+        {
+            double fraction = double(counts[i]) / total;
+            entropy -= fraction * log2(fraction);
+        }
+    }
+    return entropy;
+}
 
 
-
-//This function assumes that numbers is a vector that contains only the values
-//0 to 3.  If any other values are present, this function will crash.
-int Environment::getMode(std::vector<int> * numbers) const
+//This averages the nucleotide entropy over the positions of the mode genome.
+double Environment::getMeanNucleotideEntropy() const
 {
-    std::map<int, int> frequencies;
+    int modeGenomeLength = getModeGenomeLength();
+    if (modeGenomeLength == 0)
+        return 0.0;
+
+    double entropySum = 0.0;
+    for (int i = 0; i < modeGenomeLength; ++i)
+        entropySum += getNucleotideEntropy(i);
+    return entropySum / modeGenomeLength;
+}
+
 
-    for (size_t i = 0; i < numbers->size(); ++i)
-    {
-        std::map<int, int>::iterator it = frequencies.find((*numbers)[i]);
-        if (it == frequencies.end())
-            frequencies[(*numbers)[i]] = 1;
-        else
-            ++(it->second);
-    }
 
+//This takes the counts of the four nucleotides and returns the most common.
+//Ties go to the lowest nucleotide.
+int Environment::getNucleotideMode(const int * nucleotideCounts)
+{
     int mostCommonValue = 0;
     int highestFrequency = 0;
-    for(std::map<int, int>::iterator it = frequencies.begin();
-        it != frequencies.end(); ++it)
+    for (int i = 0; i < 4; ++i)
     {
-        if (it->second > highestFrequency)
+        if (nucleotideCounts[i] > highestFrequency)
         {
-            mostCommonValue = it->first;
-            highestFrequency = it->second;
+            mostCommonValue = i;
+            highestFrequency = nucleotideCounts[i];
         }
     }
-
     return mostCommonValue;
 }
 
@@ -720,33 +951,82 @@ int Environment::getMaxGenomeLength() const
 //anyof those either, it just chooses any organism at random.
 const Organism * Environment::getRandomGrownOrganism() const
 {
-    if (m_organisms.size() == 0)
+    std::vector<const Organism *> allOrganisms(m_organisms.begin(), m_organisms.end());
+    std::vector<const Organism *> grownOrganisms = getGrownOrganisms();
+    std::vector<const Organism *> oldOrganisms;
+    if (grownOrganisms.size() == 0)
+        oldOrganisms = getOldOrganisms();
+    return chooseRandomGrownOrganism(&grownOrganisms, &oldOrganisms, &allOrganisms);
+}
+
+const Organism * Environment::chooseRandomGrownOrganism(const std::vector<const Organism *> * grownOrganisms,
+                                                        const std::vector<const Organism *> * oldOrganisms,
+                                                        const std::vector<const Organism *> * allOrganisms)
+{
+    if (allOrganisms->size() == 0)
         return 0;
 
     //First try to find a random fully-grown organism.
-    std::vector<const Organism *> grownOrganisms = getGrownOrganisms();
-    if (grownOrganisms.size() > 0)
+    if (grownOrganisms->size() > 0)
     {
-        int randomSelection = g_randomNumbers->getRandomInt(0, int(grownOrganisms.size()) - 1);
-        return grownOrganisms[randomSelection];
+        int randomSelection = g_randomNumbers->getRandomInt(0, int(grownOrganisms->size()) - 1);
+        return (*grownOrganisms)[randomSelection];
     }
 
     //If that failed, try to find an organism that is old.
-    std::vector<const Organism *> oldOrganisms = getOldOrganisms();
-    if (oldOrganisms.size() > 0)
+    if (oldOrganisms->size() > 0)
     {
-        int randomSelection = g_randomNumbers->getRandomInt(0, int(oldOrganisms.size()) - 1);
-        return oldOrganisms[randomSelection];
+        int randomSelection = g_randomNumbers->getRandomInt(0, int(oldOrganisms->size()) - 1);
+        return (*oldOrganisms)[randomSelection];
     }
 
     //If that failed too, just select any random one from the whole population.
     else
     {
-        int randomSelection = g_randomNumbers->getRandomInt(0, int(m_organisms.size()) - 1);
-        std::list<Organism *>::const_iterator i = m_organisms.begin();
-        for (int count = 0; count < randomSelection; ++count)
-            ++i;
-        return (*i);
+        int randomSelection = g_randomNumbers->getRandomInt(0, int(allOrganisms->size()) - 1);
+        return (*allOrganisms)[randomSelection];
+    }
+}
+
+
+//This fills in the per-organism values that logging uses.  Each organism's
+//values are found in parallel, then the grown and old organisms are listed in
+//population order, so they match getGrownOrganisms and getOldOrganisms.
+void Environment::getPopulationColumns(PopulationColumns * columns) const
+{
+    size_t n = m_organisms.size();
+    columns->m_organisms.assign(m_organisms.begin(), m_organisms.end());
+    columns->m_heights.resize(n);
+    columns->m_masses.resize(n);
+    columns->m_energies.resize(n);
+    columns->m_generations.resize(n);
+    columns->m_grownOrganisms.clear();
+    columns->m_oldOrganisms.clear();
+
+    std::vector<char> grown(n), old(n);
+    double ageCutoff = g_simulationSettings->getAverageNonStarvedAge();
+    long long elapsedTime = m_elapsedTime;
+
+    tbb::parallel_for(size_t(0), n, [&](size_t i)
+    {
+        const Organism * organism = columns->m_organisms[i];
+        double mass = organism->getMass();
+        columns->m_heights[i] = organism->getHeight();
+        columns->m_masses[i] = mass;
+        columns->m_energies[i] = organism->getEnergy();
+        columns->m_generations[i] = organism->getGeneration();
+
+        //Mass requirement is to exclude organisms that grew into the ground (i.e. didn't grow at all).
+        grown[i] = organism->isFinishedGrowing() && mass > 1.0;
+        old[i] = organism->getAge(elapsedTime) >= ageCutoff && mass > 1.0;
+    });
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        if (grown[i])
+            columns->m_grownOrganisms.push_back(columns->m_organisms[i]);
+        if (old[i])
+            columns->m_oldOrganisms.push_back(columns->m_organisms[i]);
     }
 }
 
@@ -762,6 +1042,7 @@ void Environment::setWidth(int newWidth)
         {
             if ((*i)->getSeedX() > newWidth)
             {
+                removeFromPopulationTotals(*i);
                 delete *i;
                 i = m_organisms.erase(i);
                 ++(g_stats->m_numberOfOrganismsDiedFromBadLuck);
@@ -818,10 +1099,88 @@ void Environment::resetAllGenerations()
 
 void Environment::killOrganism(Organism * organism)
 {
+    removeFromPopulationTotals(organism);
     delete organism;
     m_organisms.erase(std::remove(m_organisms.begin(), m_organisms.end(), organism), m_organisms.end());
 }
 
+void Environment::clearPopulationTotals()
+{
+    m_totalSeedEnergy = 0.0;
+    m_fullyGrownPlantCount = 0;
+    m_grownBranchCount = 0;
+    m_grownLeafCount = 0;
+    m_grownSeedpodCount = 0;
+    m_grownPlantPartCount = 0;
+    m_nucleotideCounts.clear();
+    m_genomeLengthCounts.clear();
+}
+
+//This works out the running totals from scratch, e.g. after loading.
+void Environment::recalculatePopulationTotals()
+{
+    clearPopulationTotals();
+    for (std::deque<Seed>::const_iterator i = m_seeds.begin(); i != m_seeds.end(); ++i)
+    {
+        if (i->isNotNull())
+            m_totalSeedEnergy += i->getEnergy();
+    }
+    for (std::list<Organism *>::iterator i = m_organisms.begin(); i != m_organisms.end(); ++i)
+    {
+        (*i)->setCountedAsGrown(false);
+        addToPopulationTotals(*i);
+    }
+}
+
+void Environment::addToPopulationTotals(Organism * organism)
+{
+    addToNucleotideCounts(organism->getGenome(), 1);
+    updateGrownTotals(organism);
+}
+
+//Organisms make no new parts once they have finished growing, so their part
+//counts can be added to the totals when they finish and taken away again when
+//they die.
+void Environment::updateGrownTotals(Organism * organism)
+{
+    if (!organism->isCountedAsGrown() && organism->isFinishedGrowing())
+    {
+        addToGrownTotals(organism, 1);
+        organism->setCountedAsGrown(true);
+    }
+}
+
+void Environment::removeFromPopulationTotals(const Organism * organism)
+{
+    addToNucleotideCounts(organism->getGenome(), -1);
+    if (organism->isCountedAsGrown())
+        addToGrownTotals(organism, -1);
+}
+
+//Genomes don't change during an organism's life, so this is only needed when
+//organisms are born and die.
+void Environment::addToNucleotideCounts(const Genome * genome, int sign)
+{
+    int length = genome->getGenomeLength();
+    if (int(m_genomeLengthCounts.size()) <= length)
+        m_genomeLengthCounts.resize(length + 1, 0);
+    m_genomeLengthCounts[length] += sign;
+
+    if (int(m_nucleotideCounts.size()) < 4 * length)
+        m_nucleotideCounts.resize(4 * length, 0);
+    if (length > 0)
+        genome->addToNucleotideCounts(&m_nucleotideCounts[0], sign);
+}
+
+void Environment::addToGrownTotals(const Organism * organism, int sign)
+{
+    m_fullyGrownPlantCount += sign;
+    m_grownBranchCount += sign * organism->getBranchCount();
+    m_grownLeafCount += sign * organism->getLeafCount();
+    m_grownSeedpodCount += sign * organism->getSeedpodCount();
+    m_grownPlantPartCount += sign * organism->getPlantPartCount();
+}
+
 void Environment::helpOrganism(Organism * organism)
 {
     organism->help();
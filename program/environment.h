@@ -40,6 +40,20 @@
 #endif // Q_MOC_RUN
 namespace boost {namespace serialization {class access;}}
 
+//Per-organism values for the whole population, in population order.  They are
+//gathered in one parallel pass so that logging doesn't walk the organisms (and
+//recurse through their plant part trees) once for each statistic.
+struct PopulationColumns
+{
+    std::vector<const Organism *> m_organisms;
+    std::vector<double> m_heights;
+    std::vector<double> m_masses;
+    std::vector<double> m_energies;
+    std::vector<double> m_generations;
+    std::vector<const Organism *> m_grownOrganisms;
+    std::vector<const Organism *> m_oldOrganisms;
+};
+
 class Environment
 {
 public:
@@ -91,36 +105,43 @@ public:
                                    double * ninetyFifthPercentilePlantEnergy,
                                    double * ninetiethPercentilePlantEnergy,
                                    double * medianPlantEnergy) const;
-    void getPercentilesOfDoubleVector(std::vector<double> * doubleVector,
-                                      double * max,
-                                      double * ninetyNinthPercentile,
-                                      double * ninetyFifthPercentile,
-                                      double * ninetiethPercentile,
-                                      double * median) const;
-    double getPercentile(std::vector<double> * sortedDoubleVector, double percentile) const;
+    static void getPercentilesOfDoubleVector(std::vector<double> * doubleVector,
+                                             double * max,
+                                             double * ninetyNinthPercentile,
+                                             double * ninetyFifthPercentile,
+                                             double * ninetiethPercentile,
+                                             double * median);
+    static double getPercentile(const std::vector<double> * doubleVector, double percentile);
+    static int getPercentileIndex(size_t n, double percentile);
 
     double getFullyGrownPlantFraction() const;
     int getFullyGrownPlantCount() const;
     double getAverageEnergyPerSeed() const;
     double getMeanPartsPerPlant(PlantPartType partType) const;
     Genome getModeGenome() const;
+    int getModeGenomeLength() const;
+    double getNucleotideEntropy(int position) const;
+    double getMeanNucleotideEntropy() const;
     const Organism * getOldestOrganism() const;
-    int getLogIntervalMultiplier() const {return m_logIntervalMultiplier;}
     const std::list<Organism *> * getOrganismList() const {return &m_organisms;}
     int getMaxGenomeLength() const;
     const Organism *getRandomGrownOrganism() const;
+    static const Organism * chooseRandomGrownOrganism(const std::vector<const Organism *> * grownOrganisms,
+                                                      const std::vector<const Organism *> * oldOrganisms,
+                                                      const std::vector<const Organism *> * allOrganisms);
+    void getPopulationColumns(PopulationColumns * columns) const;
     double getElapsedRealWorldSeconds() const {return m_elapsedRealWorldSeconds;}
     void addToElapsedRealWorldSeconds(double newSeconds) {m_elapsedRealWorldSeconds += newSeconds;}
     double getPopulationDensity() const {return double(getOrganismCount()) / m_width;}
     double getMeanSeedsPerPlant() const {if (getOrganismCount() == 0) return 0.0; else return double(getSeedCount()) / getOrganismCount();}
     double getSunIntensity() const;
-    int getMode(std::vector<int> * numbers) const;
+    static int getNucleotideMode(const int * nucleotideCounts);
     std::vector<const Organism *> getGrownOrganisms() const;
     std::vector<const Organism *> getOldOrganisms() const;
     QString getDateAndTimeOfSimStart() const {return QString::fromStdString(m_dateAndTimeOfSimStart);}
     QDateTime getLastStartTime() const {return lastStartTime;}
     QString outputAllInfoOnCurrentPopulation() const;
-    int getLogInterval() const {return m_logIntervalMultiplier * g_simulationSettings->statLoggingInterval;}
+    int getLogInterval() const {return g_simulationSettings->statLoggingInterval;}
 
 private:
     int m_width;
@@ -129,16 +150,55 @@ private:
     std::list<Organism *> m_organisms;
     std::deque<Seed> m_seeds;
     int m_numberOfNullSeeds;
-    int m_logIntervalMultiplier;
     double m_elapsedRealWorldSeconds;
     std::string m_dateAndTimeOfSimStart;
     QDateTime lastStartTime;
 
+    //The number of non-starved organisms to check before the next one dies from
+    //bad luck, and the death rate it was drawn with.  Not saved, as a fresh draw
+    //has the same distribution.
+    long long m_organismsUntilUnluckyDeath;
+    double m_unluckyDeathRate;
+
+    //The last tick's settings, so each tick's settings generation can be worked
+    //out.  Not saved: the settled state it is used for is recomputed anyway.
+    TickSettings * m_previousTickSettings;
+
+    //Running totals for the summary stats, kept up to date as seeds and
+    //organisms come and go so the stats don't need to walk the population.
+    //The grown totals cover the organisms that have finished growing.  Not
+    //saved, as they are worked out again when a simulation is loaded.
+    double m_totalSeedEnergy;
+    int m_fullyGrownPlantCount;
+    int m_grownBranchCount;
+    int m_grownLeafCount;
+    int m_grownSeedpodCount;
+    int m_grownPlantPartCount;
+
+    //The number of organisms with each nucleotide at each genome position (four
+    //counters per position) and with each genome length, so the mode genome
+    //can be read without looking at every genome.
+    std::vector<int> m_nucleotideCounts;
+    std::vector<int> m_genomeLengthCounts;
+
+    void advanceOneDayTick(const TickSettings & settings);
+    void growOrganisms(const TickSettings & settings, bool nightTick);
+    void advanceOneNightTick(const TickSettings & settings);
     void killOffStarvedAndUnluckyOrganisms();
+    bool nextOrganismIsUnlucky();
     void getRidOfOldSeeds();
-    void createNewOrganisms();
+    void createSeeds(const TickSettings & settings);
+    void createNewOrganisms(const TickSettings & settings);
     void distributeLightToLeaves();
     void limitPlantEnergyToMaximum();
+    void limitPlantEnergyToMaximum(std::list<Organism *>::iterator firstOrganism);
+    void clearPopulationTotals();
+    void recalculatePopulationTotals();
+    void addToPopulationTotals(Organism * organism);
+    void updateGrownTotals(Organism * organism);
+    void addToNucleotideCounts(const Genome * genome, int sign);
+    void removeFromPopulationTotals(const Organism * organism);
+    void addToGrownTotals(const Organism * organism, int sign);
 
 signals:
     void addToWaitingDialog(QString text);
@@ -153,9 +213,18 @@ signals:
         ar & m_organisms;
         ar & m_seeds;
         ar & m_numberOfNullSeeds;
-        ar & m_logIntervalMultiplier;
+
+        //Old saves have a log interval multiplier, from when the interval
+        //doubled as the log filled up.  It is still in the archive so they
+        //load, but it is always 1 now.
+        int logIntervalMultiplier = 1;
+        ar & logIntervalMultiplier;
+
         ar & m_elapsedRealWorldSeconds;
         ar & m_dateAndTimeOfSimStart;
+
+        if (Archive::is_loading::value)
+            recalculatePopulationTotals();
     }
 };
 
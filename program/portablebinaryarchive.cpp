@@ -0,0 +1,209 @@
+//Copyright 2015 Ryan Wick
+
+//This file is part of Grovolve.
+
+//Grovolve is free software: you can redistribute it and/or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+
+//Grovolve is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with Grovolve.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "portablebinaryarchive.h"
+#include <stdint.h>
+#include <cstring>
+#include "boost/static_assert.hpp"
+#include "boost/archive/archive_exception.hpp"
+#include "boost/archive/impl/archive_serializer_map.ipp"
+#include "boost/archive/impl/basic_binary_oprimitive.ipp"
+#include "boost/archive/impl/basic_binary_iprimitive.ipp"
+#include "boost/archive/impl/basic_binary_oarchive.ipp"
+#include "boost/archive/impl/basic_binary_iarchive.ipp"
+
+//Floating point values are saved as their bits, so they must be in the same
+//format everywhere.
+BOOST_STATIC_ASSERT(std::numeric_limits<float>::is_iec559 && sizeof(float) == 4);
+BOOST_STATIC_ASSERT(std::numeric_limits<double>::is_iec559 && sizeof(double) == 8);
+
+
+PortableBinaryOArchive::PortableBinaryOArchive(std::ostream & os) :
+    boost::archive::basic_binary_oprimitive<PortableBinaryOArchive, std::ostream::char_type,
+                                            std::ostream::traits_type>(*os.rdbuf(), false),
+    boost::archive::basic_binary_oarchive<PortableBinaryOArchive>(0)
+{
+    saveHeader();
+}
+
+
+void PortableBinaryOArchive::saveInteger(unsigned long long value, int size)
+{
+    char bytes[8];
+    for (int i = 0; i < size; ++i)
+        bytes[i] = char((value >> (8 * i)) & 0xff);
+    save_binary(bytes, size);
+}
+
+void PortableBinaryOArchive::save(const float & t)
+{
+    uint32_t bits;
+    memcpy(&bits, &t, 4);
+    saveInteger(bits, 4);
+}
+
+void PortableBinaryOArchive::save(const double & t)
+{
+    uint64_t bits;
+    memcpy(&bits, &t, 8);
+    saveInteger(bits, 8);
+}
+
+void PortableBinaryOArchive::save(const std::string & t)
+{
+    saveInteger(t.size(), 8);
+    if (!t.empty())
+        save_binary(t.data(), t.size());
+}
+
+
+//This is the same header boost's binary archives have, the signature and the
+//version of the serialization library, but written like everything else.
+void PortableBinaryOArchive::saveHeader()
+{
+    save(std::string(boost::archive::BOOST_ARCHIVE_SIGNATURE()));
+    save(boost::archive::library_version_type(boost::archive::BOOST_ARCHIVE_VERSION()));
+}
+
+
+
+
+PortableBinaryIArchive::PortableBinaryIArchive(std::istream & is) :
+    boost::archive::basic_binary_iprimitive<PortableBinaryIArchive, std::istream::char_type,
+                                            std::istream::traits_type>(*is.rdbuf(), false),
+    boost::archive::basic_binary_iarchive<PortableBinaryIArchive>(0)
+{
+    loadHeader();
+}
+
+
+unsigned long long PortableBinaryIArchive::loadBits(int size)
+{
+    char bytes[8];
+    load_binary(bytes, size);
+    unsigned long long bits = 0;
+    for (int i = 0; i < size; ++i)
+        bits |= (unsigned long long)((unsigned char)bytes[i]) << (8 * i);
+    return bits;
+}
+
+void PortableBinaryIArchive::throwOutOfRange()
+{
+    throw boost::archive::archive_exception(boost::archive::archive_exception::other_exception,
+                                            "value out of range for its type");
+}
+
+void PortableBinaryIArchive::load(float & t)
+{
+    uint32_t bits = uint32_t(loadBits(4));
+    memcpy(&t, &bits, 4);
+}
+
+void PortableBinaryIArchive::load(double & t)
+{
+    uint64_t bits = loadBits(8);
+    memcpy(&t, &bits, 8);
+}
+
+void PortableBinaryIArchive::load(std::string & t)
+{
+    std::size_t size;
+    loadInteger(size, 8);
+    t.resize(size);
+    if (size > 0)
+        load_binary(&t[0], size);
+}
+
+
+void PortableBinaryIArchive::load(boost::archive::tracking_type & t)
+{
+    bool value;
+    loadInteger(value, 1);
+    t = boost::archive::tracking_type(value);
+}
+
+void PortableBinaryIArchive::load(boost::archive::class_id_type & t)
+{
+    short value;
+    loadInteger(value, 2);
+    t = boost::archive::class_id_type(int(value));
+}
+
+void PortableBinaryIArchive::load(boost::archive::object_id_type & t)
+{
+    unsigned int value;
+    loadInteger(value, 4);
+    t = boost::archive::object_id_type(value);
+}
+
+void PortableBinaryIArchive::load(boost::archive::version_type & t)
+{
+    unsigned int value;
+    loadInteger(value, 4);
+    t = boost::archive::version_type(value);
+}
+
+void PortableBinaryIArchive::load(boost::archive::library_version_type & t)
+{
+    unsigned int value;
+    loadInteger(value, 2);
+    t = boost::archive::library_version_type(value);
+}
+
+void PortableBinaryIArchive::load(boost::serialization::item_version_type & t)
+{
+    unsigned int value;
+    loadInteger(value, 4);
+    t = boost::serialization::item_version_type(value);
+}
+
+void PortableBinaryIArchive::load(boost::serialization::collection_size_type & t)
+{
+    std::size_t value;
+    loadInteger(value, 8);
+    t = boost::serialization::collection_size_type(value);
+}
+
+
+//The archive can't be read if it was saved by a newer version of the
+//serialization library than this one.
+void PortableBinaryIArchive::loadHeader()
+{
+    std::string signature;
+    load(signature);
+    if (signature != boost::archive::BOOST_ARCHIVE_SIGNATURE())
+        throw boost::archive::archive_exception(boost::archive::archive_exception::invalid_signature);
+
+    boost::archive::library_version_type libraryVersion;
+    load(libraryVersion);
+    set_library_version(libraryVersion);
+    if (boost::archive::BOOST_ARCHIVE_VERSION() < libraryVersion)
+        throw boost::archive::archive_exception(boost::archive::archive_exception::unsupported_version);
+}
+
+
+namespace boost {
+namespace archive {
+template class detail::archive_serializer_map<PortableBinaryOArchive>;
+template class detail::archive_serializer_map<PortableBinaryIArchive>;
+template class basic_binary_oprimitive<PortableBinaryOArchive, std::ostream::char_type, std::ostream::traits_type>;
+template class basic_binary_iprimitive<PortableBinaryIArchive, std::istream::char_type, std::istream::traits_type>;
+template class basic_binary_oarchive<PortableBinaryOArchive>;
+template class basic_binary_iarchive<PortableBinaryIArchive>;
+}
+}
@@ -0,0 +1,154 @@
+//Copyright 2015 Ryan Wick
+
+//This file is part of Grovolve.
+
+//Grovolve is free software: you can redistribute it and/or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+
+//Grovolve is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with Grovolve.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef PORTABLEBINARYARCHIVE_H
+#define PORTABLEBINARYARCHIVE_H
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <limits>
+
+#ifndef Q_MOC_RUN
+#include "boost/archive/basic_archive.hpp"
+#include "boost/archive/basic_binary_oprimitive.hpp"
+#include "boost/archive/basic_binary_iprimitive.hpp"
+#include "boost/archive/basic_binary_oarchive.hpp"
+#include "boost/archive/basic_binary_iarchive.hpp"
+#include "boost/archive/detail/register_archive.hpp"
+#include "boost/serialization/collection_size_type.hpp"
+#include "boost/serialization/item_version_type.hpp"
+#endif // Q_MOC_RUN
+
+//boost's binary archives write each value as its bytes in memory, so a file
+//depends on the type sizes and byte order of the platform that saved it (e.g.
+//a long is 4 bytes on Windows but 8 on Linux).  These archives write every
+//value with a fixed size, whatever the platform, and little-endian:
+//bool and char types 1 byte, short 2, int 4, long, long long and collection
+//sizes 8, and float and double as their IEEE 754 bits in 4 and 8 bytes.
+//When a value is loaded into a type too small for it, an archive_exception is
+//thrown.
+
+class PortableBinaryOArchive :
+        public boost::archive::basic_binary_oprimitive<PortableBinaryOArchive, std::ostream::char_type,
+                                                       std::ostream::traits_type>,
+        public boost::archive::basic_binary_oarchive<PortableBinaryOArchive>
+{
+public:
+    PortableBinaryOArchive(std::ostream & os);
+
+    void save(const bool & t) {saveInteger(t, 1);}
+    void save(const char & t) {saveInteger(t, 1);}
+    void save(const signed char & t) {saveInteger(t, 1);}
+    void save(const unsigned char & t) {saveInteger(t, 1);}
+    void save(const short & t) {saveInteger(t, 2);}
+    void save(const unsigned short & t) {saveInteger(t, 2);}
+    void save(const int & t) {saveInteger(t, 4);}
+    void save(const unsigned int & t) {saveInteger(t, 4);}
+    void save(const long & t) {saveInteger(t, 8);}
+    void save(const unsigned long & t) {saveInteger(t, 8);}
+    void save(const long long & t) {saveInteger(t, 8);}
+    void save(const unsigned long long & t) {saveInteger(t, 8);}
+    void save(const float & t);
+    void save(const double & t);
+    void save(const std::string & t);
+
+    //These are the values boost adds to the archive to describe the objects.
+    void save(const boost::archive::tracking_type & t) {saveInteger(bool(t), 1);}
+    void save(const boost::archive::class_id_type & t) {saveInteger(int(t), 2);}
+    void save(const boost::archive::object_id_type & t) {saveInteger((unsigned int)(t), 4);}
+    void save(const boost::archive::version_type & t) {saveInteger((unsigned int)(t), 4);}
+    void save(const boost::archive::library_version_type & t) {saveInteger((unsigned int)(t), 2);}
+    void save(const boost::serialization::item_version_type & t) {saveInteger((unsigned int)(t), 4);}
+    void save(const boost::serialization::collection_size_type & t) {saveInteger(std::size_t(t), 8);}
+
+private:
+    friend class boost::archive::basic_binary_oarchive<PortableBinaryOArchive>;
+
+    void saveInteger(unsigned long long value, int size);
+    void saveHeader();
+};
+
+
+class PortableBinaryIArchive :
+        public boost::archive::basic_binary_iprimitive<PortableBinaryIArchive, std::istream::char_type,
+                                                       std::istream::traits_type>,
+        public boost::archive::basic_binary_iarchive<PortableBinaryIArchive>
+{
+public:
+    PortableBinaryIArchive(std::istream & is);
+
+    void load(bool & t) {loadInteger(t, 1);}
+    void load(char & t) {loadInteger(t, 1);}
+    void load(signed char & t) {loadInteger(t, 1);}
+    void load(unsigned char & t) {loadInteger(t, 1);}
+    void load(short & t) {loadInteger(t, 2);}
+    void load(unsigned short & t) {loadInteger(t, 2);}
+    void load(int & t) {loadInteger(t, 4);}
+    void load(unsigned int & t) {loadInteger(t, 4);}
+    void load(long & t) {loadInteger(t, 8);}
+    void load(unsigned long & t) {loadInteger(t, 8);}
+    void load(long long & t) {loadInteger(t, 8);}
+    void load(unsigned long long & t) {loadInteger(t, 8);}
+    void load(float & t);
+    void load(double & t);
+    void load(std::string & t);
+
+    void load(boost::archive::tracking_type & t);
+    void load(boost::archive::class_id_type & t);
+    void load(boost::archive::object_id_type & t);
+    void load(boost::archive::version_type & t);
+    void load(boost::archive::library_version_type & t);
+    void load(boost::serialization::item_version_type & t);
+    void load(boost::serialization::collection_size_type & t);
+
+private:
+    friend class boost::archive::basic_binary_iarchive<PortableBinaryIArchive>;
+
+    unsigned long long loadBits(int size);
+    static void throwOutOfRange();
+    void loadHeader();
+
+    //The bits are sign extended for signed types, then checked against the
+    //range of the type they are loaded into.
+    template<typename T>
+    void loadInteger(T & t, int size)
+    {
+        unsigned long long bits = loadBits(size);
+        if (std::numeric_limits<T>::is_signed)
+        {
+            if (size < 8 && (bits >> (8 * size - 1)) != 0)
+                bits |= ~0ULL << (8 * size);
+            long long value = (long long)bits;
+            if (value < (long long)std::numeric_limits<T>::min() || value > (long long)std::numeric_limits<T>::max())
+                throwOutOfRange();
+            t = T(value);
+        }
+        else
+        {
+            if (bits > (unsigned long long)std::numeric_limits<T>::max())
+                throwOutOfRange();
+            t = T(bits);
+        }
+    }
+};
+
+BOOST_SERIALIZATION_REGISTER_ARCHIVE(PortableBinaryOArchive)
+BOOST_SERIALIZATION_REGISTER_ARCHIVE(PortableBinaryIArchive)
+
+#endif // PORTABLEBINARYARCHIVE_H
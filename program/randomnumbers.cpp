@@ -18,16 +18,31 @@
 
 #include "randomnumbers.h"
 #include <QTime>
+#include <math.h>
+#include <limits>
 
 RandomNumbers::RandomNumbers()
 {
     QTime midnight(0, 0, 0);
     int seed = midnight.msecsTo(QTime::currentTime());
     m_random.seed(seed);
+    createDistributions();
+}
+
+//This constructor is used to give a task its own stream of random numbers,
+//seeded from the main generator, so results don't depend on thread timing.
+RandomNumbers::RandomNumbers(unsigned int seed)
+{
+    m_random.seed(seed);
+    createDistributions();
+}
 
+void RandomNumbers::createDistributions()
+{
     m_randomZeroToOne = new boost::random::uniform_01<>();
     m_randomZeroToThree = new boost::random::uniform_smallint<>(0, 3);
     m_randomZeroOrOne = new boost::random::uniform_smallint<>(0, 1);
+    m_randomOneToThree = new boost::random::uniform_smallint<>(1, 3);
 }
 
 RandomNumbers::~RandomNumbers()
@@ -35,6 +50,7 @@ RandomNumbers::~RandomNumbers()
     delete m_randomZeroToOne;
     delete m_randomZeroToThree;
     delete m_randomZeroOrOne;
+    delete m_randomOneToThree;
 }
 
 
@@ -76,6 +92,25 @@ int RandomNumbers::changeDoubleToProbabilisticInt(double input)
 
 
 
+//This function gives the number of failed trials before the next success, when
+//each trial independently succeeds with the given chance (a geometric
+//distribution).  Drawing this once replaces drawing chanceOfTrue for every
+//trial, which saves a lot of random numbers when the chance is small.
+long long RandomNumbers::getTrialsBeforeSuccess(double chance)
+{
+    if (chance >= 1.0)
+        return 0;
+    if (chance <= 0.0)
+        return std::numeric_limits<long long>::max();
+
+    double trials = floor(log(1.0 - getRandomZeroToOne()) / log(1.0 - chance));
+    if (trials >= double(std::numeric_limits<long long>::max()))
+        return std::numeric_limits<long long>::max();
+    return (long long)(trials);
+}
+
+
+
 //This function gives a mutation count given genome size and mutation rate.
 //It is assumed that each nucleotide has an independent chance of mutating.
 //While a binomial distribution is the exact distribution for this scenario,
@@ -94,6 +129,8 @@ int RandomNumbers::getMutationCount(int genomeSize, double mutationChance)
 //chance of crossover is equal at each nucleotide.
 int RandomNumbers::getCrossoverFragmentLength(double meanFragmentLength)
 {
-    boost::random::exponential_distribution<> fragLength(1.0 / meanFragmentLength);
-    return fragLength(m_random);
+    double lambda = 1.0 / meanFragmentLength;
+    if (m_crossoverFragmentLength.lambda() != lambda)
+        m_crossoverFragmentLength.param(boost::random::exponential_distribution<>::param_type(lambda));
+    return m_crossoverFragmentLength(m_random);
 }
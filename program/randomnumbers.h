@@ -34,6 +34,7 @@ class RandomNumbers
 {
 public:
     RandomNumbers();
+    RandomNumbers(unsigned int seed);
     ~RandomNumbers();
 
     double getRandomDouble(double min, double max);
@@ -41,18 +42,28 @@ public:
     double getRandomZeroToOne() {return (*m_randomZeroToOne)(m_random);}
     int getRandomZeroOrOne() {return (*m_randomZeroOrOne)(m_random);}
     char getRandomZeroToThree() {return (*m_randomZeroToThree)(m_random);}
+    int getRandomOneToThree() {return (*m_randomOneToThree)(m_random);}
     bool chanceOfTrue(double chance) {return getRandomZeroToOne() < chance;}
     int changeDoubleToProbabilisticInt(double input);
+    long long getTrialsBeforeSuccess(double chance);
     double getRandomExponential(double lambda);
     bool fiftyPercentChance() {return getRandomZeroOrOne() == 0;}
     int getMutationCount(int nucleotides, double mutationChance);
     int getCrossoverFragmentLength(double meanFragmentLength);
+    unsigned int getRandomSeed() {return m_random();}
 
 private:
     boost::random::mt19937 m_random;
     boost::random::uniform_01<> * m_randomZeroToOne;
     boost::random::uniform_smallint<> * m_randomZeroToThree;
     boost::random::uniform_smallint<> * m_randomZeroOrOne;
+    boost::random::uniform_smallint<> * m_randomOneToThree;
+
+    //Kept between calls (and only updated when the mean changes) as crossover
+    //fragment lengths are drawn many times for every new genome.
+    boost::random::exponential_distribution<> m_crossoverFragmentLength;
+
+    void createDistributions();
 };
 
 #endif // RANDOMNUMBERS_H
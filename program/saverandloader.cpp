@@ -21,24 +21,62 @@
 #include "../settings/environmentsettings.h"
 #include "../settings/simulationsettings.h"
 #include "stats.h"
+#include "blockgzip.h"
+#include "portablebinaryarchive.h"
 #include "../plant/genome.h"
 #include "../plant/plantpart.h"
 #include "../plant/organism.h"
 #include "../plant/seed.h"
 #include <fstream>
+#include <sstream>
+#include <cstring>
+#include <algorithm>
+#include <cstdio>
+#include <QFile>
+#include "boost/archive/archive_exception.hpp"
 #include "boost/archive/text_iarchive.hpp"
-#include "boost/archive/text_oarchive.hpp"
 #include "boost/iostreams/filtering_stream.hpp"
 #include "boost/iostreams/filter/gzip.hpp"
 
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+
+static void writeLittleEndian(char * bytes, long long value, int size)
+{
+    for (int i = 0; i < size; ++i)
+        bytes[i] = char((value >> (8 * i)) & 0xff);
+}
+
+static long long readLittleEndian(const char * bytes, int size)
+{
+    unsigned long long value = 0;
+    for (int i = 0; i < size; ++i)
+        value |= (unsigned long long)((unsigned char)bytes[i]) << (8 * i);
+    return (long long)value;
+}
+
+//This puts one file in place of another in a single step, so there is always a
+//complete file under the name, even if the program stops part way through.
+static bool replaceFile(QString newFileName, QString fileName)
+{
+#ifdef _WIN32
+    return MoveFileExW(reinterpret_cast<const wchar_t *>(newFileName.utf16()),
+                       reinterpret_cast<const wchar_t *>(fileName.utf16()),
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return std::rename(newFileName.toLocal8Bit().data(), fileName.toLocal8Bit().data()) == 0;
+#endif
+}
+
+
+
 
 void SaverAndLoader::saveSimulation()
 {
     std::ofstream ofs(m_fullFileName.toLocal8Bit().data(), std::ios_base::out | std::ios::binary);
-    boost::iostreams::filtering_ostream out;
-    out.push(boost::iostreams::gzip_compressor(1)); //1 is the compression level - I chose a low one for speed.
-    out.push(ofs);
-    boost::archive::text_oarchive ar(out);
 
     Stats * tempStats;
     long long elapsedTime = 0;
@@ -50,7 +88,21 @@ void SaverAndLoader::saveSimulation()
         std::swap(m_stats, tempStats);
     }
 
-    ar << *m_environment << *m_environmentSettings << *m_simulationSettings << *m_stats;
+    //The table of contents is written with empty entries at first, then again
+    //once the sections are written and their places in the file are known.
+    std::vector<SaveFileSectionLocation> sections(SAVE_FILE_SECTION_COUNT);
+    writeTableOfContents(&ofs, sections);
+    for (int i = 0; i < SAVE_FILE_SECTION_COUNT; ++i)
+    {
+        sections[i].m_offset = ofs.tellp();
+        BlockGzipOutputBuffer compressor(&ofs, 1); //1 is the compression level - I chose a low one for speed.
+        std::ostream out(&compressor);
+        saveSection(&out, SaveFileSection(i), m_environment, m_environmentSettings, m_simulationSettings, m_stats);
+        compressor.finish();
+        sections[i].m_length = (long long)(ofs.tellp()) - sections[i].m_offset;
+    }
+    ofs.seekp(0);
+    writeTableOfContents(&ofs, sections);
 
     if (!m_history)
     {
@@ -62,6 +114,143 @@ void SaverAndLoader::saveSimulation()
     emit finishedSaving();
 }
 
+//This serializes the simulation into memory, uncompressed.  It is much quicker
+//than a full save, as there is no compression or disk access, so it can be done
+//between ticks.  The history, the largest part, isn't serialized here: only
+//its records are copied, and they are archived by writeSnapshot.  The copy
+//doesn't change as the simulation runs, so it can then be written out by
+//writeSnapshot on another thread.
+boost::shared_ptr<SaveFileSnapshot> SaverAndLoader::makeSnapshot(Environment * environment,
+                                                                 EnvironmentSettings * environmentSettings,
+                                                                 SimulationSettings * simulationSettings, Stats * stats)
+{
+    boost::shared_ptr<SaveFileSnapshot> snapshot(new SaveFileSnapshot());
+    for (int i = 0; i < HISTORY_SECTION; ++i)
+    {
+        std::ostringstream sectionStream;
+        saveSection(&sectionStream, SaveFileSection(i), environment, environmentSettings, simulationSettings, stats);
+        snapshot->m_sections.push_back(sectionStream.str());
+    }
+    stats->m_log.getHistory(&snapshot->m_history);
+    return snapshot;
+}
+
+
+//The snapshot is written to a temporary file which then replaces the save
+//file, so a save that is cut short never leaves a broken file in its place.
+//If the write fails (e.g. the disk is full), the old save file is kept.
+void SaverAndLoader::writeSnapshot()
+{
+    QString temporaryFileName = m_fullFileName + ".part";
+    bool written;
+    {
+        std::ofstream ofs(temporaryFileName.toLocal8Bit().data(), std::ios_base::out | std::ios::binary);
+        std::vector<SaveFileSectionLocation> sections(SAVE_FILE_SECTION_COUNT);
+        writeTableOfContents(&ofs, sections);
+        for (int i = 0; i < SAVE_FILE_SECTION_COUNT; ++i)
+        {
+            sections[i].m_offset = ofs.tellp();
+            BlockGzipOutputBuffer compressor(&ofs, 1); //1 is the compression level - I chose a low one for speed.
+            if (i == HISTORY_SECTION)
+            {
+                std::ostream out(&compressor);
+                saveHistorySection(&out, m_snapshot->m_history);
+            }
+            else
+            {
+                const std::string & section = m_snapshot->m_sections[i];
+                compressor.sputn(section.data(), section.size());
+            }
+            compressor.finish();
+            sections[i].m_length = (long long)(ofs.tellp()) - sections[i].m_offset;
+        }
+        ofs.seekp(0);
+        writeTableOfContents(&ofs, sections);
+        written = ofs.good();
+        ofs.close();
+        written = written && !ofs.fail();
+    }
+    m_snapshot.reset();
+
+    if (!written || !replaceFile(temporaryFileName, m_fullFileName))
+        QFile::remove(temporaryFileName);
+
+    emit finishedSaving();
+}
+
+
+//Each section is a separate archive, so it can be loaded without the others.
+void SaverAndLoader::saveSection(std::ostream * out, SaveFileSection section, Environment * environment,
+                                 EnvironmentSettings * environmentSettings,
+                                 SimulationSettings * simulationSettings, Stats * stats)
+{
+    if (section == HISTORY_SECTION)
+    {
+        StatsLogHistory history;
+        stats->m_log.getHistory(&history);
+        saveHistorySection(out, history);
+        return;
+    }
+
+    PortableBinaryOArchive ar(*out);
+    if (section == SETTINGS_SECTION)
+        ar << *environmentSettings << *simulationSettings;
+    else if (section == POPULATION_SECTION)
+        ar << *environment;
+    else if (section == STATS_SECTION)
+        ar << *stats;
+}
+
+void SaverAndLoader::saveHistorySection(std::ostream * out, const StatsLogHistory & history)
+{
+    PortableBinaryOArchive ar(*out);
+    ar << history;
+}
+
+
+//The table of contents block is stored without compression, so it is the same
+//size when it is written again over the first one.
+void SaverAndLoader::writeTableOfContents(std::ostream * out, const std::vector<SaveFileSectionLocation> & sections)
+{
+    std::vector<char> contents(SAVE_FILE_HEADER_SIZE + 4 + 16 * sections.size());
+    memcpy(contents.data(), SAVE_FILE_MAGIC, 8);
+    writeLittleEndian(contents.data() + 8, SAVE_FILE_VERSION, 4);
+    writeLittleEndian(contents.data() + 12, sections.size(), 4);
+    for (size_t i = 0; i < sections.size(); ++i)
+    {
+        writeLittleEndian(contents.data() + 16 + 16 * i, sections[i].m_offset, 8);
+        writeLittleEndian(contents.data() + 24 + 16 * i, sections[i].m_length, 8);
+    }
+
+    BlockGzipOutputBuffer compressor(out, 0);
+    compressor.sputn(contents.data(), contents.size());
+    compressor.finish();
+}
+
+
+//This reads the table of contents that follows the header.  There is always an
+//entry for each section this version knows about, but if the file is damaged
+//they may be empty.
+std::vector<SaveFileSectionLocation> SaverAndLoader::readTableOfContents(std::istream * in)
+{
+    std::vector<SaveFileSectionLocation> sections(SAVE_FILE_SECTION_COUNT);
+    char countBytes[4];
+    if (!in->read(countBytes, 4))
+        return sections;
+
+    int count = std::min(int(readLittleEndian(countBytes, 4)), int(SAVE_FILE_SECTION_COUNT));
+    for (int i = 0; i < count; ++i)
+    {
+        char location[16];
+        if (!in->read(location, 16))
+            break;
+        sections[i].m_offset = readLittleEndian(location, 8);
+        sections[i].m_length = readLittleEndian(location + 8, 8);
+    }
+    return sections;
+}
+
+
 void SaverAndLoader::loadSimulation()
 {
     //It is awkward to load whether the program is in basic or advanced mode, so
@@ -72,12 +261,29 @@ void SaverAndLoader::loadSimulation()
     bool advancedModeBeforeLoad = m_simulationSettings->advancedMode;
 
     std::ifstream ifs(m_fullFileName.toLocal8Bit().data(), std::ios_base::in | std::ios_base::binary);
-    boost::iostreams::filtering_istream in;
-    in.push(boost::iostreams::gzip_decompressor());
-    in.push(ifs);
-    boost::archive::text_iarchive ar(in);
+    std::streamoff firstBlockSize = BlockGzipInputBuffer::getFirstBlockSize(&ifs);
 
-    ar >> *m_environment >> *m_environmentSettings >> *m_simulationSettings >> *m_stats;
+    //Files from before the sectioned format don't start with a table of
+    //contents block.  They are a single gzipped text archive.
+    if (firstBlockSize == 0)
+    {
+        boost::iostreams::filtering_istream in;
+        in.push(boost::iostreams::gzip_decompressor());
+        in.push(ifs);
+        boost::archive::text_iarchive ar(in);
+        ar >> *m_environment >> *m_environmentSettings >> *m_simulationSettings >> *m_stats;
+    }
+    else
+    {
+        std::vector<SaveFileSectionLocation> sections;
+        {
+            BlockGzipInputBuffer decompressor(&ifs, firstBlockSize);
+            std::istream in(&decompressor);
+            readHeader(&in);
+            sections = readTableOfContents(&in);
+        }
+        loadSections(&ifs, sections);
+    }
 
     m_simulationSettings->advancedMode = advancedModeBeforeLoad;
 
@@ -85,3 +291,69 @@ void SaverAndLoader::loadSimulation()
 }
 
 
+//Everything but the history is loaded now.  The stats are given a function to
+//load the history later, which they usually run in the background.  A file
+//whose table of contents has no history section just has no history, but the
+//other sections are needed.
+void SaverAndLoader::loadSections(std::istream * in, const std::vector<SaveFileSectionLocation> & sections)
+{
+    for (int i = SETTINGS_SECTION; i < HISTORY_SECTION; ++i)
+    {
+        if (sections[i].m_length <= 0)
+            throw boost::archive::archive_exception(boost::archive::archive_exception::input_stream_error);
+        in->clear();
+        in->seekg(sections[i].m_offset);
+        BlockGzipInputBuffer decompressor(in, sections[i].m_length);
+        std::istream sectionStream(&decompressor);
+        PortableBinaryIArchive ar(sectionStream);
+        if (i == SETTINGS_SECTION)
+            ar >> *m_environmentSettings >> *m_simulationSettings;
+        else if (i == POPULATION_SECTION)
+            ar >> *m_environment;
+        else if (i == STATS_SECTION)
+            ar >> *m_stats;
+    }
+
+    SaveFileSectionLocation location = sections[HISTORY_SECTION];
+    if (location.m_length <= 0)
+        return;
+    std::string fileName(m_fullFileName.toLocal8Bit().data());
+    m_stats->setHistoryLoader([fileName, location](StatsLogHistory * history)
+                              {return loadHistorySection(fileName, location, history);});
+}
+
+
+//This runs after the load has finished, usually in the background, so nothing
+//could catch an exception from it.  If the history can't be read, it is left
+//empty and false is returned, so the stats can report it.
+bool SaverAndLoader::loadHistorySection(std::string fileName, SaveFileSectionLocation location,
+                                        StatsLogHistory * history)
+{
+    try
+    {
+        std::ifstream ifs(fileName.c_str(), std::ios_base::in | std::ios_base::binary);
+        ifs.seekg(location.m_offset);
+        BlockGzipInputBuffer decompressor(&ifs, location.m_length);
+        std::istream in(&decompressor);
+        PortableBinaryIArchive ar(in);
+        ar >> *history;
+    }
+    catch (...)
+    {
+        *history = StatsLogHistory();
+        return false;
+    }
+    return true;
+}
+
+
+//This checks the header at the start of the table of contents block.  A file
+//from a newer version of the format can't be loaded.
+void SaverAndLoader::readHeader(std::istream * in)
+{
+    char header[SAVE_FILE_HEADER_SIZE];
+    if (!in->read(header, SAVE_FILE_HEADER_SIZE) || memcmp(header, SAVE_FILE_MAGIC, 8) != 0)
+        throw boost::archive::archive_exception(boost::archive::archive_exception::invalid_signature);
+    if (readLittleEndian(header + 8, 4) != SAVE_FILE_VERSION)
+        throw boost::archive::archive_exception(boost::archive::archive_exception::unsupported_version);
+}
@@ -21,12 +21,56 @@
 
 #include <QObject>
 #include <QString>
+#include <string>
+#include <vector>
+#include <iosfwd>
+#include "statslog.h"
+
+#ifndef Q_MOC_RUN
+#include "boost/shared_ptr.hpp"
+#endif // Q_MOC_RUN
 
 class Environment;
 class EnvironmentSettings;
 class SimulationSettings;
 class Stats;
 
+//A save file is made of sections, each compressed on its own (see
+//blockgzip.h) and holding one portable binary archive (see
+//portablebinaryarchive.h), so a file saved on one platform can be loaded on
+//any other.  The first block of the file is the table of contents: the 8
+//characters "GROVSAVE", the format version as a 32-bit little-endian integer,
+//the number of sections, then the offset and length in the file of each
+//section as 64-bit little-endian integers.
+//The sections are in the order they are loaded.  Everything needed to carry on
+//with the simulation comes first, and the history, which is the largest part of
+//the stats, is loaded afterwards in the background.
+//Files without the table of contents block are text archives from earlier
+//versions, and can still be loaded.
+const char SAVE_FILE_MAGIC[] = "GROVSAVE";
+const int SAVE_FILE_VERSION = 1;
+const int SAVE_FILE_HEADER_SIZE = 12;
+
+enum SaveFileSection {SETTINGS_SECTION, POPULATION_SECTION, STATS_SECTION, HISTORY_SECTION,
+                      SAVE_FILE_SECTION_COUNT};
+
+struct SaveFileSectionLocation
+{
+    SaveFileSectionLocation() : m_offset(0), m_length(0) {}
+    long long m_offset;
+    long long m_length;
+};
+
+//A copy of the simulation that can be written out on another thread: the
+//uncompressed archive of each section before the history, in section order,
+//and the history records themselves.  The records share their genomes with the
+//log, so they are quick to copy, and are only archived when written out.
+struct SaveFileSnapshot
+{
+    std::vector<std::string> m_sections;
+    StatsLogHistory m_history;
+};
+
 class SaverAndLoader : public QObject
 {
     Q_OBJECT
@@ -40,6 +84,13 @@ public:
         m_environmentSettings(environmentSettings),
         m_simulationSettings(simulationSettings), m_stats(stats),
         m_history(history) {}
+    SaverAndLoader(QString fullFileName, boost::shared_ptr<SaveFileSnapshot> snapshot) :
+        m_fullFileName(fullFileName), m_environment(0), m_environmentSettings(0),
+        m_simulationSettings(0), m_stats(0), m_history(true), m_snapshot(snapshot) {}
+
+    static boost::shared_ptr<SaveFileSnapshot> makeSnapshot(Environment * environment,
+                                                            EnvironmentSettings * environmentSettings,
+                                                            SimulationSettings * simulationSettings, Stats * stats);
 
 private:
     QString m_fullFileName;
@@ -48,9 +99,22 @@ private:
     SimulationSettings * m_simulationSettings;
     Stats * m_stats;
     bool m_history;
+    boost::shared_ptr<SaveFileSnapshot> m_snapshot;
+
+    static void saveSection(std::ostream * out, SaveFileSection section, Environment * environment,
+                            EnvironmentSettings * environmentSettings,
+                            SimulationSettings * simulationSettings, Stats * stats);
+    static void saveHistorySection(std::ostream * out, const StatsLogHistory & history);
+    static void writeTableOfContents(std::ostream * out, const std::vector<SaveFileSectionLocation> & sections);
+    static std::vector<SaveFileSectionLocation> readTableOfContents(std::istream * in);
+    static void readHeader(std::istream * in);
+    void loadSections(std::istream * in, const std::vector<SaveFileSectionLocation> & sections);
+    static bool loadHistorySection(std::string fileName, SaveFileSectionLocation location,
+                                   StatsLogHistory * history);
 
 public slots:
     void saveSimulation();
+    void writeSnapshot();
     void loadSimulation();
 
 signals:
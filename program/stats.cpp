@@ -19,199 +19,315 @@
 #include "stats.h"
 #include "environment.h"
 #include "../settings/simulationsettings.h"
+#include "../settings/ticksettings.h"
 #include "../plant/organism.h"
+#include <algorithm>
 
-Stats::Stats()
+Stats::Stats() :
+    m_logPending(false), m_pendingEntryReady(false), m_historyLoading(false), m_historyLoadFailed(false)
 {
     reset();
 }
 
 Stats::~Stats()
 {
+    discardLoadingHistory();
+    finishPendingLog();
     cleanUp();
 }
 
 
 void Stats::reset()
 {
+    discardLoadingHistory();
+    finishPendingLog();
+
     m_numberOfOrganismsSprouted = 0;
     m_numberOfOrganismsDiedFromBadLuck = 0;
     m_numberOfOrganismsDiedFromStarvation = 0;
     m_numberOfSeedsGenerated = 0;
 
     cleanUp();
+    restartLogFile();
 }
 
 void Stats::cleanUp()
 {
-    m_time.clear();
-    m_populationDensity.clear();
-
-    m_tallestPlantHeight.clear();
-    m_99thPercentilePlantHeight.clear();
-    m_95thPercentilePlantHeight.clear();
-    m_90thPercentilePlantHeight.clear();
-    m_medianPlantHeight.clear();
-
-    m_heaviestPlantMass.clear();
-    m_99thPercentilePlantMass.clear();
-    m_95thPercentilePlantMass.clear();
-    m_90thPercentilePlantMass.clear();
-    m_medianPlantMass.clear();
-
-    m_mostPlantEnergy.clear();
-    m_99thPercentilePlantEnergy.clear();
-    m_95thPercentilePlantEnergy.clear();
-    m_90thPercentilePlantEnergy.clear();
-    m_medianPlantEnergy.clear();
-
-    m_meanSeedsPerPlant.clear();
-    m_meanEnergyPerSeed.clear();
-
-    for (std::vector<Organism *>::const_iterator i = m_averageGenomeOrganism.begin();
-         i != m_averageGenomeOrganism.end(); ++i)
-        delete *i;
-    m_averageGenomeOrganism.clear();
-
-    for (std::vector<Organism *>::const_iterator i = m_randomGenomeOrganism.begin();
-         i != m_randomGenomeOrganism.end(); ++i)
-        delete *i;
-    m_randomGenomeOrganism.clear();
+    m_log.clear();
+    clearHistoryOrganismCache();
+}
+
+void Stats::clearHistoryOrganismCache()
+{
+    for (std::list<std::pair<boost::shared_ptr<Genome>, Organism *> >::const_iterator i = m_historyOrganismCache.begin();
+         i != m_historyOrganismCache.end(); ++i)
+        delete i->second;
+    m_historyOrganismCache.clear();
 }
 
 
 
 
+//This takes a snapshot of the population and starts making the log entry in
+//the background.  The entry is added to the logged data by finishPendingLog,
+//which is called before the next entry is made and before anything that needs
+//the log to be complete, like saving.
+//The random organism is chosen here, so the random numbers drawn are the same
+//as if the entry were made right away.
 void Stats::addToLog(Environment * environment)
 {
-    m_time.push_back(environment->getElapsedTime());
-    m_populationDensity.push_back(environment->getPopulationDensity());
-
-    double tallestPlantHeight;
-    double ninetyNinthPercentilePlantHeight;
-    double ninetyFifthPercentilePlantHeight;
-    double ninetiethPercentilePlantHeight;
-    double medianPlantHeight;
-    environment->getPlantHeightPercentiles(&tallestPlantHeight,
-                                           &ninetyNinthPercentilePlantHeight,
-                                           &ninetyFifthPercentilePlantHeight,
-                                           &ninetiethPercentilePlantHeight,
-                                           &medianPlantHeight);
-    m_tallestPlantHeight.push_back(tallestPlantHeight);
-    m_99thPercentilePlantHeight.push_back(ninetyNinthPercentilePlantHeight);
-    m_95thPercentilePlantHeight.push_back(ninetyFifthPercentilePlantHeight);
-    m_90thPercentilePlantHeight.push_back(ninetiethPercentilePlantHeight);
-    m_medianPlantHeight.push_back(medianPlantHeight);
-
-    double heaviestPlantMass;
-    double ninetyNinthPercentilePlantMass;
-    double ninetyFifthPercentilePlantMass;
-    double ninetiethPercentilePlantMass;
-    double medianPlantMass;
-    environment->getPlantMassPercentiles(&heaviestPlantMass,
-                                         &ninetyNinthPercentilePlantMass,
-                                         &ninetyFifthPercentilePlantMass,
-                                         &ninetiethPercentilePlantMass,
-                                         &medianPlantMass);
-    m_heaviestPlantMass.push_back(heaviestPlantMass);
-    m_99thPercentilePlantMass.push_back(ninetyNinthPercentilePlantMass);
-    m_95thPercentilePlantMass.push_back(ninetyFifthPercentilePlantMass);
-    m_90thPercentilePlantMass.push_back(ninetiethPercentilePlantMass);
-    m_medianPlantMass.push_back(medianPlantMass);
-
-    double mostPlantEnergy;
-    double ninetyNinthPercentilePlantEnergy;
-    double ninetyFifthPercentilePlantEnergy;
-    double ninetiethPercentilePlantEnergy;
-    double medianPlantEnergy;
-    environment->getPlantEnergyPercentiles(&mostPlantEnergy,
-                                           &ninetyNinthPercentilePlantEnergy,
-                                           &ninetyFifthPercentilePlantEnergy,
-                                           &ninetiethPercentilePlantEnergy,
-                                           &medianPlantEnergy);
-    m_mostPlantEnergy.push_back(mostPlantEnergy);
-    m_99thPercentilePlantEnergy.push_back(ninetyNinthPercentilePlantEnergy);
-    m_95thPercentilePlantEnergy.push_back(ninetyFifthPercentilePlantEnergy);
-    m_90thPercentilePlantEnergy.push_back(ninetiethPercentilePlantEnergy);
-    m_medianPlantEnergy.push_back(medianPlantEnergy);
-
-    m_meanSeedsPerPlant.push_back(environment->getMeanSeedsPerPlant());
-    m_meanEnergyPerSeed.push_back(environment->getAverageEnergyPerSeed());
-
-    if (environment->getOrganismCount() == 0)
+    finishPendingLog();
+
+    boost::shared_ptr<LogSnapshot> snapshot(new LogSnapshot());
+    snapshot->m_time = environment->getElapsedTime();
+    snapshot->m_historyOrganismAge = getHistoryOrganismAge();
+    snapshot->m_populationDensity = environment->getPopulationDensity();
+    snapshot->m_meanSeedsPerPlant = environment->getMeanSeedsPerPlant();
+    snapshot->m_meanEnergyPerSeed = environment->getAverageEnergyPerSeed();
+
+    PopulationColumns population;
+    environment->getPopulationColumns(&population);
+
+    if (population.m_organisms.size() > 0)
     {
-        m_averageGenomeOrganism.push_back(0);
-        m_randomGenomeOrganism.push_back(0);
+        double generationSum = 0.0;
+        for (size_t i = 0; i < population.m_generations.size(); ++i)
+            generationSum += population.m_generations[i];
+        snapshot->m_averageGeneration = generationSum / population.m_generations.size();
+        snapshot->m_modeGenome = environment->getModeGenome();
+
+        const Organism * randomOrganism = Environment::chooseRandomGrownOrganism(&population.m_grownOrganisms,
+                                                                                 &population.m_oldOrganisms,
+                                                                                 &population.m_organisms);
+        snapshot->m_randomGenome = *(randomOrganism->getGenome());
+        snapshot->m_randomGeneration = randomOrganism->getGeneration();
+    }
+
+    snapshot->m_heights.swap(population.m_heights);
+    snapshot->m_masses.swap(population.m_masses);
+    snapshot->m_energies.swap(population.m_energies);
+
+    m_logPending = true;
+    m_pendingEntryReady = false;
+    LogEntry * entry = &m_pendingEntry;
+    std::atomic<bool> * ready = &m_pendingEntryReady;
+    m_logWorker.run([snapshot, entry, ready]{makeLogEntry(snapshot.get(), entry); *ready = true;});
+}
+
+
+//This does the slow work of making a log entry.  It only uses the snapshot, so
+//it can run while the simulation continues.
+void Stats::makeLogEntry(LogSnapshot * snapshot, LogEntry * entry)
+{
+    entry->m_time = snapshot->m_time;
+    double * values = entry->m_values;
+    values[POPULATION] = snapshot->m_populationDensity;
+    values[SEED_COUNT] = snapshot->m_meanSeedsPerPlant;
+    values[ENERGY_PER_SEED] = snapshot->m_meanEnergyPerSeed;
+
+    Environment::getPercentilesOfDoubleVector(&snapshot->m_heights,
+                                              &values[TALLEST_PLANT], &values[NINETY_NINTH_PERCENTILE_PLANT_HEIGHT],
+                                              &values[NINETY_FIFTH_PERCENTILE_PLANT_HEIGHT], &values[NINETIETH_PERCENTILE_PLANT_HEIGHT],
+                                              &values[MEDIAN_PLANT_HEIGHT]);
+    Environment::getPercentilesOfDoubleVector(&snapshot->m_masses,
+                                              &values[HEAVIEST_PLANT], &values[NINETY_NINTH_PERCENTILE_PLANT_MASS],
+                                              &values[NINETY_FIFTH_PERCENTILE_PLANT_MASS], &values[NINETIETH_PERCENTILE_PLANT_MASS],
+                                              &values[MEDIAN_PLANT_MASS]);
+    Environment::getPercentilesOfDoubleVector(&snapshot->m_energies,
+                                              &values[MOST_PLANT_ENERGY], &values[NINETY_NINTH_PERCENTILE_PLANT_ENERGY],
+                                              &values[NINETY_FIFTH_PERCENTILE_PLANT_ENERGY], &values[NINETIETH_PERCENTILE_PLANT_ENERGY],
+                                              &values[MEDIAN_PLANT_ENERGY]);
+
+    if (snapshot->m_heights.size() == 0)
+    {
+        entry->m_averageGenome = HistoryRecord();
+        entry->m_randomGenome = HistoryRecord();
     }
     else
     {
-        Organism * newAverageGenomeOrganism = new Organism(environment->getModeGenome(),
-                                                           environment->getAverageGeneration());
-        newAverageGenomeOrganism->age(2 * g_simulationSettings->getAverageNonStarvedAge());  //Double the non-starved age should be enough...
-        m_averageGenomeOrganism.push_back(newAverageGenomeOrganism);
-
-        const Organism * randomOrganism = environment->getRandomGrownOrganism();
-        Organism * newRandomGenomeOrganism = new Organism(*(randomOrganism->getGenome()),
-                                                          randomOrganism->getGeneration());
-        newRandomGenomeOrganism->age(2 * g_simulationSettings->getAverageNonStarvedAge());
-        m_randomGenomeOrganism.push_back(newRandomGenomeOrganism);
+        boost::shared_ptr<Genome> averageGenome(new Genome(snapshot->m_modeGenome));
+        entry->m_averageGenome = makeHistoryRecord(averageGenome, snapshot->m_averageGeneration,
+                                                   snapshot->m_historySettings, snapshot->m_historyOrganismAge);
+
+        boost::shared_ptr<Genome> randomGenome(new Genome(snapshot->m_randomGenome));
+        entry->m_randomGenome = makeHistoryRecord(randomGenome, snapshot->m_randomGeneration,
+                                                  snapshot->m_historySettings, snapshot->m_historyOrganismAge);
     }
 }
 
 
+//The organism is grown once here to find how far it extends, then thrown away.
+//It will be grown again if it is displayed.  It grows from its own copy of the
+//genome, so the stored genome is left without any decoded genes.
+HistoryRecord Stats::makeHistoryRecord(boost::shared_ptr<Genome> genome, double generation,
+                                       const TickSettings & settings, int age)
+{
+    Organism * organism = growHistoryOrganism(*genome, generation, settings, age);
+    HistoryRecord record(genome, generation, organism);
+    delete organism;
+    return record;
+}
 
-//Should only be called when there are an even number of data points in each vector.
-void Stats::deleteHalfOfAllData()
+
+//This only uses the settings and age it is given, not the global settings, so
+//it can run in the background.
+Organism * Stats::growHistoryOrganism(const Genome & genome, double generation,
+                                      const TickSettings & settings, int age)
 {
-    deleteHalfOfOneDoubleDataGroup(&m_time);
-    deleteHalfOfOneDoubleDataGroup(&m_populationDensity);
-
-    deleteHalfOfOneDoubleDataGroup(&m_tallestPlantHeight);
-    deleteHalfOfOneDoubleDataGroup(&m_99thPercentilePlantHeight);
-    deleteHalfOfOneDoubleDataGroup(&m_95thPercentilePlantHeight);
-    deleteHalfOfOneDoubleDataGroup(&m_90thPercentilePlantHeight);
-    deleteHalfOfOneDoubleDataGroup(&m_medianPlantHeight);
-
-    deleteHalfOfOneDoubleDataGroup(&m_heaviestPlantMass);
-    deleteHalfOfOneDoubleDataGroup(&m_99thPercentilePlantMass);
-    deleteHalfOfOneDoubleDataGroup(&m_95thPercentilePlantMass);
-    deleteHalfOfOneDoubleDataGroup(&m_90thPercentilePlantMass);
-    deleteHalfOfOneDoubleDataGroup(&m_medianPlantMass);
-
-    deleteHalfOfOneDoubleDataGroup(&m_mostPlantEnergy);
-    deleteHalfOfOneDoubleDataGroup(&m_99thPercentilePlantEnergy);
-    deleteHalfOfOneDoubleDataGroup(&m_95thPercentilePlantEnergy);
-    deleteHalfOfOneDoubleDataGroup(&m_90thPercentilePlantEnergy);
-    deleteHalfOfOneDoubleDataGroup(&m_medianPlantEnergy);
-
-    deleteHalfOfOneDoubleDataGroup(&m_meanSeedsPerPlant);
-    deleteHalfOfOneDoubleDataGroup(&m_meanEnergyPerSeed);
-
-    deleteHalfOfOneOrganismDataGroup(&m_averageGenomeOrganism);
-    deleteHalfOfOneOrganismDataGroup(&m_randomGenomeOrganism);
+    Organism * organism = new Organism(genome, generation, settings);
+    organism->age(age, settings);
+    return organism;
 }
 
+int Stats::getHistoryOrganismAge()
+{
+    return 2 * g_simulationSettings->getAverageNonStarvedAge();  //Double the non-starved age should be enough...
+}
+
+
+//If a log entry is being made in the background, this waits for it and adds it
+//to the logged data.  It must be called from the main thread.
+void Stats::finishPendingLog()
+{
+    finishLoadingHistory();
+    if (!m_logPending)
+        return;
+    m_logWorker.wait();
+    m_logPending = false;
+
+    const LogEntry & entry = m_pendingEntry;
+    m_log.add(entry.m_time, entry.m_values, entry.m_averageGenome, entry.m_randomGenome);
+    m_logFile.append(entry.m_time, entry.m_values);
+}
 
-void Stats::deleteHalfOfOneDoubleDataGroup(std::vector<double> * data)
+//This adds the pending log entry only if it is already made, so it never waits.
+//It lets the UI show new entries without holding up the simulation.
+void Stats::finishPendingLogIfReady()
 {
-    std::vector<double> newData;
-    for (size_t i = 0; i < data->size(); i += 2)
-        newData.push_back((*data)[i]);
-    *data = newData;
+    if (m_logPending && m_pendingEntryReady)
+        finishPendingLog();
 }
 
 
-void Stats::deleteHalfOfOneOrganismDataGroup(std::vector<Organism *> * data)
+
+//This starts a new log file holding the entries logged so far.  Entries that
+//were merged before the file was opened are written at the resolution they
+//now have, as their samples are gone.
+bool Stats::openLogFile(QString fileName)
+{
+    finishPendingLog();
+    if (!m_logFile.open(fileName))
+        return false;
+    appendLogToFile(-1.0);
+    return true;
+}
+
+//This writes the logged entries after the given time to the log file.
+void Stats::appendLogToFile(double afterTime)
 {
-    std::vector<Organism *> newData;
-    for (size_t i = 0; i < data->size(); ++i)
+    double values[LOGGED_STAT_COUNT];
+    for (int i = 0; i < m_log.size(); ++i)
     {
-        if (i % 2 == 0)
-            newData.push_back((*data)[i]);
-        else
-            delete (*data)[i];
+        if (m_log.getTime(i) <= afterTime)
+            continue;
+        for (int stat = 0; stat < LOGGED_STAT_COUNT; ++stat)
+            values[stat] = m_log.getMean(GraphData(stat), i);
+        m_logFile.append(m_log.getTime(i), values);
     }
-    *data = newData;
+}
+
+//Returns an empty string if no log file is open.
+QString Stats::getLogFileName() const
+{
+    if (!m_logFile.isOpen())
+        return "";
+    return m_logFile.getFileName();
+}
+
+//Used when the logged data is replaced, by a reset or a load, so the log file
+//matches the simulation it is next to.  The file's records up to the last
+//logged time are kept, as they are at full resolution, and only the entries
+//after them are written from the log.
+//There is never a pending entry here, as the log has just been replaced, so
+//this doesn't wait for any history that is still loading.
+void Stats::restartLogFile()
+{
+    if (!m_logFile.isOpen())
+        return;
+
+    double loggedTime = -1.0;
+    if (m_log.size() > 0)
+        loggedTime = m_log.getTime(m_log.size() - 1);
+    double lastKeptTime;
+    if (m_logFile.reopen(m_logFile.getFileName(), loggedTime, &lastKeptTime))
+        appendLogToFile(lastKeptTime);
+}
+
+
+
+//This is called once the rest of the stats are loaded.  The loader function
+//reads the history records from the save file into the history it is given.
+//It must not throw: if the records can't be read, it leaves the history empty
+//and returns false.
+void Stats::setHistoryLoader(std::function<bool(StatsLogHistory *)> loader)
+{
+    discardLoadingHistory();
+    m_historyLoadFunction = loader;
+}
+
+//This starts the history loading in the background, so it is usually done by
+//the time it is needed.  It must be called from the main thread.
+void Stats::startLoadingHistory()
+{
+    if (!m_historyLoadFunction || m_historyLoading)
+        return;
+    m_historyLoading = true;
+    std::function<bool(StatsLogHistory *)> loader = m_historyLoadFunction;
+    StatsLogHistory * history = &m_loadedHistory;
+    bool * failed = &m_historyLoadFailed;
+    m_historyLoader.run([loader, history, failed]{*failed = !loader(history);});
+}
+
+//If there is history to load, this waits for it (or loads it now, if it
+//wasn't started) and puts it into the log.  It must be called from the main
+//thread.
+void Stats::finishLoadingHistory()
+{
+    if (!m_historyLoadFunction)
+        return;
+    if (m_historyLoading)
+        m_historyLoader.wait();
+    else
+        m_historyLoadFailed = !m_historyLoadFunction(&m_loadedHistory);
+    m_historyLoading = false;
+    m_historyLoadFunction = nullptr;
+
+    m_log.setHistory(&m_loadedHistory);
+    m_loadedHistory = StatsLogHistory();
+}
+
+//Used when the log is about to be replaced, so its history is no longer wanted.
+void Stats::discardLoadingHistory()
+{
+    if (m_historyLoading)
+        m_historyLoader.wait();
+    m_historyLoading = false;
+    m_historyLoadFunction = nullptr;
+    m_historyLoadFailed = false;
+    m_loadedHistory = StatsLogHistory();
+}
+
+//This returns true once after a history failed to load, so the failure is
+//only reported once.  While the history is loading, m_historyLoadFailed is
+//written in the background, so it is only read once finishLoadingHistory has
+//waited for the loader.
+bool Stats::takeHistoryLoadFailure()
+{
+    if (m_historyLoading)
+        return false;
+    bool failed = m_historyLoadFailed;
+    m_historyLoadFailed = false;
+    return failed;
 }
 
 
@@ -220,67 +336,125 @@ void Stats::deleteHalfOfOneOrganismDataGroup(std::vector<Organism *> * data)
 //COULD BE MUCH IMPROVED.
 double Stats::getHistoryOrganismHeightExtent(HistoryOrganismType historyOrganismType)
 {
+    finishLoadingHistory();
     double maxHeight = 0.0;
 
-    std::vector<Organism *>::const_iterator i = getBeginIterator(historyOrganismType);
-    std::vector<Organism *>::const_iterator end = getEndIterator(historyOrganismType);
-    for (; i != end; ++i)
+    for (int i = 0; i < m_log.size(); ++i)
     {
-        if ((*i) != 0)
-        {
-            double organismHighPoint = (*i)->getHighestDrawnPoint();
-            if (organismHighPoint > maxHeight)
-                maxHeight = organismHighPoint;
-        }
+        const HistoryRecord & record = m_log.getHistoryRecord(historyOrganismType, i);
+        if (!record.isEmpty() && record.m_highestDrawnPoint > maxHeight)
+            maxHeight = record.m_highestDrawnPoint;
     }
     return maxHeight;
 }
 double Stats::getHistoryOrganismRightExtent(HistoryOrganismType historyOrganismType)
 {
+    finishLoadingHistory();
     double maxRight = 0.0;
 
-    std::vector<Organism *>::const_iterator i = getBeginIterator(historyOrganismType);
-    std::vector<Organism *>::const_iterator end = getEndIterator(historyOrganismType);
-    for (; i != end; ++i)
+    for (int i = 0; i < m_log.size(); ++i)
     {
-        if ((*i) != 0)
-        {
-            double organismRightPoint = (*i)->getRightmostDrawnPoint();
-            if (organismRightPoint > maxRight)
-                maxRight = organismRightPoint;
-        }
+        const HistoryRecord & record = m_log.getHistoryRecord(historyOrganismType, i);
+        if (!record.isEmpty() && record.m_rightmostDrawnPoint > maxRight)
+            maxRight = record.m_rightmostDrawnPoint;
     }
     return maxRight;
 }
 double Stats::getHistoryOrganismLeftExtent(HistoryOrganismType historyOrganismType)
 {
+    finishLoadingHistory();
     double minLeft = std::numeric_limits<double>::max();
 
-    std::vector<Organism *>::const_iterator i = getBeginIterator(historyOrganismType);
-    std::vector<Organism *>::const_iterator end = getEndIterator(historyOrganismType);
-    for (; i != end; ++i)
+    for (int i = 0; i < m_log.size(); ++i)
     {
-        if ((*i) != 0)
+        const HistoryRecord & record = m_log.getHistoryRecord(historyOrganismType, i);
+        if (!record.isEmpty() && record.m_leftmostDrawnPoint < minLeft)
+            minLeft = record.m_leftmostDrawnPoint;
+    }
+    return minLeft;
+}
+
+const HistoryRecord & Stats::getHistoryRecord(HistoryOrganismType historyOrganismType, int index)
+{
+    finishLoadingHistory();
+    return m_log.getHistoryRecord(historyOrganismType, index);
+}
+
+
+
+//This returns the grown organism for one history record, or null if the
+//population was empty at that time.  Recently viewed organisms are cached, as
+//the user usually moves back and forth through nearby records.  The returned
+//organism stays valid until historyOrganismCacheSize other organisms have been
+//viewed or the stats are reset.
+const Organism * Stats::getHistoryOrganism(HistoryOrganismType historyOrganismType, int index)
+{
+    const HistoryRecord & record = getHistoryRecord(historyOrganismType, index);
+    if (record.isEmpty())
+        return 0;
+
+    for (std::list<std::pair<boost::shared_ptr<Genome>, Organism *> >::iterator i = m_historyOrganismCache.begin();
+         i != m_historyOrganismCache.end(); ++i)
+    {
+        if (i->first == record.m_genome)
         {
-            double organismLeftPoint = (*i)->getLeftmostDrawnPoint();
-            if (organismLeftPoint < minLeft)
-                minLeft = organismLeftPoint;
+            m_historyOrganismCache.splice(m_historyOrganismCache.begin(), m_historyOrganismCache, i);
+            return i->second;
         }
     }
-    return minLeft;
+
+    TickSettings settings;
+    Organism * organism = growHistoryOrganism(*record.m_genome, record.m_generation, settings, getHistoryOrganismAge());
+    m_historyOrganismCache.push_front(std::make_pair(record.m_genome, organism));
+
+    while (int(m_historyOrganismCache.size()) > std::max(1, g_simulationSettings->historyOrganismCacheSize))
+    {
+        delete m_historyOrganismCache.back().second;
+        m_historyOrganismCache.pop_back();
+    }
+
+    return organism;
 }
 
-std::vector<Organism *>::const_iterator Stats::getBeginIterator(HistoryOrganismType historyOrganismType)
+
+
+//Used when loading files that stored fully grown history organisms.  Only the
+//genomes and extents are kept, and the organisms are deleted.
+void Stats::setHistoryFromOrganisms(std::vector<Organism *> * organisms, std::vector<HistoryRecord> * history)
 {
-    if (historyOrganismType == AVERAGE_GENOME)
-        return m_averageGenomeOrganism.begin();
-    else
-        return m_randomGenomeOrganism.begin();
+    history->clear();
+    for (std::vector<Organism *>::const_iterator i = organisms->begin(); i != organisms->end(); ++i)
+    {
+        if (*i == 0)
+            history->push_back(HistoryRecord());
+        else
+        {
+            boost::shared_ptr<Genome> genome(new Genome(*((*i)->getGenome())));
+            history->push_back(HistoryRecord(genome, (*i)->getGeneration(), *i));
+            delete *i;
+        }
+    }
+    organisms->clear();
 }
-std::vector<Organism *>::const_iterator Stats::getEndIterator(HistoryOrganismType historyOrganismType)
+
+
+
+//Used when loading files that stored each stat in its own vector.  The entries
+//are added to the log in order, as if they were being logged again.
+void Stats::setLogFromVectors(std::vector<double> * time, std::vector<std::vector<double> > * values,
+                              std::vector<HistoryRecord> * averageGenomeHistory,
+                              std::vector<HistoryRecord> * randomGenomeHistory)
 {
-    if (historyOrganismType == AVERAGE_GENOME)
-        return m_averageGenomeOrganism.end();
-    else
-        return m_randomGenomeOrganism.end();
+    m_log.clear();
+    for (size_t i = 0; i < time->size(); ++i)
+    {
+        double entryValues[LOGGED_STAT_COUNT];
+        for (int stat = 0; stat < LOGGED_STAT_COUNT; ++stat)
+            entryValues[stat] = (*values)[stat][i];
+        m_log.add((*time)[i], entryValues, (*averageGenomeHistory)[i], (*randomGenomeHistory)[i]);
+    }
+    time->clear();
+    values->clear();
+    averageGenomeHistory->clear();
+    randomGenomeHistory->clear();
 }
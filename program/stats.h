@@ -20,18 +20,61 @@
 #define STATS_H
 
 #include <vector>
+#include <list>
 #include "globals.h"
+#include "../plant/genome.h"
+#include "../settings/ticksettings.h"
+#include "statslog.h"
+#include "statslogfile.h"
 
 #ifndef Q_MOC_RUN
 #include "boost/serialization/vector.hpp"
 #include "boost/archive/text_iarchive.hpp"
 #include "boost/archive/text_oarchive.hpp"
+#include "boost/shared_ptr.hpp"
+#include "boost/serialization/shared_ptr.hpp"
+#include "boost/serialization/version.hpp"
+#include "tbb/task_group.h"
+#include <atomic>
+#include <functional>
 #endif // Q_MOC_RUN
 namespace boost {namespace serialization {class access;}}
 
 class Environment;
 class Organism;
 
+//The population data that one log entry is made from.  It is quick to gather,
+//so it is taken on the simulation thread.  The slow parts of logging are then
+//done from it in the background: selecting the percentiles and growing the two
+//history organisms.  The settings and age the history organisms are grown with
+//are taken here too, as the global settings can change while they are grown.
+struct LogSnapshot
+{
+    double m_time;
+    double m_populationDensity;
+    double m_meanSeedsPerPlant;
+    double m_meanEnergyPerSeed;
+    std::vector<double> m_heights;
+    std::vector<double> m_masses;
+    std::vector<double> m_energies;
+    Genome m_modeGenome;
+    double m_averageGeneration;
+    Genome m_randomGenome;
+    double m_randomGeneration;
+    TickSettings m_historySettings;
+    int m_historyOrganismAge;
+};
+
+//A finished log entry that is waiting to be added to the logged data.  The
+//values are indexed by GraphData.
+struct LogEntry
+{
+    double m_time;
+    double m_values[LOGGED_STAT_COUNT];
+    HistoryRecord m_averageGenome;
+    HistoryRecord m_randomGenome;
+};
+
 class Stats
 {
 public:
@@ -43,84 +86,107 @@ public:
     long long m_numberOfOrganismsDiedFromStarvation;
     long long m_numberOfSeedsGenerated;
 
-    std::vector<double> m_time;
-    std::vector<double> m_populationDensity;
-
-    std::vector<double> m_tallestPlantHeight;
-    std::vector<double> m_99thPercentilePlantHeight;
-    std::vector<double> m_95thPercentilePlantHeight;
-    std::vector<double> m_90thPercentilePlantHeight;
-    std::vector<double> m_medianPlantHeight;
-
-    std::vector<double> m_heaviestPlantMass;
-    std::vector<double> m_99thPercentilePlantMass;
-    std::vector<double> m_95thPercentilePlantMass;
-    std::vector<double> m_90thPercentilePlantMass;
-    std::vector<double> m_medianPlantMass;
-
-    std::vector<double> m_mostPlantEnergy;
-    std::vector<double> m_99thPercentilePlantEnergy;
-    std::vector<double> m_95thPercentilePlantEnergy;
-    std::vector<double> m_90thPercentilePlantEnergy;
-    std::vector<double> m_medianPlantEnergy;
-
-    std::vector<double> m_meanSeedsPerPlant;
-    std::vector<double> m_meanEnergyPerSeed;
-
-    std::vector<Organism *> m_averageGenomeOrganism;
-    std::vector<Organism *> m_randomGenomeOrganism;
+    StatsLog m_log;
 
     void reset();
     void addToLog(Environment * environment);
-    void deleteHalfOfAllData();
-    int logEntries() const {return int(m_time.size());}
+    void finishPendingLog();
+    void finishPendingLogIfReady();
+    int logEntries() const {return m_log.size();}
+    bool openLogFile(QString fileName);
+    void closeLogFile() {m_logFile.close();}
+    QString getLogFileName() const;
+    void restartLogFile();
+    void setHistoryLoader(std::function<bool(StatsLogHistory *)> loader);
+    void startLoadingHistory();
+    void finishLoadingHistory();
+    bool takeHistoryLoadFailure();
     double getHistoryOrganismHeightExtent(HistoryOrganismType historyOrganismType);
     double getHistoryOrganismRightExtent(HistoryOrganismType historyOrganismType);
     double getHistoryOrganismLeftExtent(HistoryOrganismType historyOrganismType);
+    const HistoryRecord & getHistoryRecord(HistoryOrganismType historyOrganismType, int index);
+    const Organism * getHistoryOrganism(HistoryOrganismType historyOrganismType, int index);
 
 private:
+    //Log entries are made on m_logWorker.  At most one is pending at a time and
+    //it is only added to the logged data by finishPendingLog, which is called
+    //from the main thread, so the logged data is never changed in the background.
+    tbb::task_group m_logWorker;
+    LogEntry m_pendingEntry;
+    bool m_logPending;
+    std::atomic<bool> m_pendingEntryReady;
+
+    //When a simulation is loaded, the history records can be read after the rest
+    //of it, by the loader function given to setHistoryLoader, in the background.
+    //They are put into the log by finishLoadingHistory, which is called before
+    //the history is used or the log is changed.  If the loader fails, the
+    //history is left empty and m_historyLoadFailed is set until it is reported.
+    tbb::task_group m_historyLoader;
+    std::function<bool(StatsLogHistory *)> m_historyLoadFunction;
+    bool m_historyLoading;
+    bool m_historyLoadFailed;
+    StatsLogHistory m_loadedHistory;
+
+    //When open, every log entry is also appended to this file at full
+    //resolution.  It isn't saved with the simulation.
+    StatsLogFile m_logFile;
+
+    //Grown history organisms, most recently used first, each with the genome it
+    //was grown from.  Holding the genome keeps it from being freed (and its
+    //address reused) while the organism is cached.
+    std::list<std::pair<boost::shared_ptr<Genome>, Organism *> > m_historyOrganismCache;
+
+    static void makeLogEntry(LogSnapshot * snapshot, LogEntry * entry);
+    static HistoryRecord makeHistoryRecord(boost::shared_ptr<Genome> genome, double generation,
+                                           const TickSettings & settings, int age);
+    static Organism * growHistoryOrganism(const Genome & genome, double generation,
+                                          const TickSettings & settings, int age);
+    static int getHistoryOrganismAge();
     void cleanUp();
-    void deleteHalfOfOneDoubleDataGroup(std::vector<double> * data);
-    void deleteHalfOfOneOrganismDataGroup(std::vector<Organism *> * data);
-    std::vector<Organism *>::const_iterator getBeginIterator(HistoryOrganismType historyOrganismType);
-    std::vector<Organism *>::const_iterator getEndIterator(HistoryOrganismType historyOrganismType);
+    void clearHistoryOrganismCache();
+    void appendLogToFile(double afterTime);
+    void discardLoadingHistory();
+    void setHistoryFromOrganisms(std::vector<Organism *> * organisms, std::vector<HistoryRecord> * history);
+    void setLogFromVectors(std::vector<double> * time, std::vector<std::vector<double> > * values,
+                           std::vector<HistoryRecord> * averageGenomeHistory,
+                           std::vector<HistoryRecord> * randomGenomeHistory);
 
     friend class boost::serialization::access;
     template<typename Archive>
-    void serialize(Archive & ar, const unsigned)
+    void serialize(Archive & ar, const unsigned version)
     {
         ar & m_numberOfOrganismsSprouted;
         ar & m_numberOfOrganismsDiedFromBadLuck;
         ar & m_numberOfOrganismsDiedFromStarvation;
         ar & m_numberOfSeedsGenerated;
 
-        ar & m_time;
-        ar & m_populationDensity;
-
-        ar & m_tallestPlantHeight;
-        ar & m_99thPercentilePlantHeight;
-        ar & m_95thPercentilePlantHeight;
-        ar & m_90thPercentilePlantHeight;
-        ar & m_medianPlantHeight;
-
-        ar & m_heaviestPlantMass;
-        ar & m_99thPercentilePlantMass;
-        ar & m_95thPercentilePlantMass;
-        ar & m_90thPercentilePlantMass;
-        ar & m_medianPlantMass;
-
-        ar & m_mostPlantEnergy;
-        ar & m_99thPercentilePlantEnergy;
-        ar & m_95thPercentilePlantEnergy;
-        ar & m_90thPercentilePlantEnergy;
-        ar & m_medianPlantEnergy;
-
-        ar & m_meanSeedsPerPlant;
-        ar & m_meanEnergyPerSeed;
-
-        ar & m_averageGenomeOrganism;
-        ar & m_randomGenomeOrganism;
+        if (version >= 1)
+        {
+            ar & m_log;
+            return;
+        }
+
+        //Files saved before version 1 hold a time vector and then one vector
+        //for each stat, in GraphData order, then fully grown history organisms.
+        //They are replayed into the log, keeping only the organisms' genomes.
+        std::vector<double> time;
+        std::vector<std::vector<double> > values(LOGGED_STAT_COUNT);
+        ar & time;
+        for (int i = 0; i < LOGGED_STAT_COUNT; ++i)
+            ar & values[i];
+
+        std::vector<Organism *> averageGenomeOrganisms;
+        std::vector<Organism *> randomGenomeOrganisms;
+        ar & averageGenomeOrganisms;
+        ar & randomGenomeOrganisms;
+        std::vector<HistoryRecord> averageGenomeHistory;
+        std::vector<HistoryRecord> randomGenomeHistory;
+        setHistoryFromOrganisms(&averageGenomeOrganisms, &averageGenomeHistory);
+        setHistoryFromOrganisms(&randomGenomeOrganisms, &randomGenomeHistory);
+        setLogFromVectors(&time, &values, &averageGenomeHistory, &randomGenomeHistory);
     }
 };
 
+BOOST_CLASS_VERSION(Stats, 1)
+
 #endif // STATS_H
@@ -0,0 +1,243 @@
+//Copyright 2015 Ryan Wick
+
+//This file is part of Grovolve.
+
+//Grovolve is free software: you can redistribute it and/or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+
+//Grovolve is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with Grovolve.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "statslog.h"
+#include "../settings/simulationsettings.h"
+#include "../plant/organism.h"
+#include <algorithm>
+
+HistoryRecord::HistoryRecord(boost::shared_ptr<Genome> genome, double generation, const Organism * grownOrganism) :
+    m_genome(genome), m_generation(generation),
+    m_highestDrawnPoint(grownOrganism->getHighestDrawnPoint()),
+    m_rightmostDrawnPoint(grownOrganism->getRightmostDrawnPoint()),
+    m_leftmostDrawnPoint(grownOrganism->getLeftmostDrawnPoint())
+{
+}
+
+
+
+
+StatsLogLevel::StatsLogLevel(int capacity) :
+    m_capacity(capacity), m_first(0), m_size(0),
+    m_time(capacity),
+    m_mean(LOGGED_STAT_COUNT * capacity),
+    m_min(LOGGED_STAT_COUNT * capacity),
+    m_max(LOGGED_STAT_COUNT * capacity),
+    m_averageGenomeHistory(capacity),
+    m_randomGenomeHistory(capacity)
+{
+}
+
+
+const HistoryRecord & StatsLogLevel::getHistoryRecord(HistoryOrganismType historyOrganismType, int index) const
+{
+    if (historyOrganismType == AVERAGE_GENOME)
+        return m_averageGenomeHistory[slot(index)];
+    else
+        return m_randomGenomeHistory[slot(index)];
+}
+
+
+//Should only be called when the level isn't full.
+void StatsLogLevel::add(double time, const double * mean, const double * min, const double * max,
+                        const HistoryRecord & averageGenome, const HistoryRecord & randomGenome)
+{
+    int newSlot = slot(m_size);
+    m_time[newSlot] = time;
+    for (int stat = 0; stat < LOGGED_STAT_COUNT; ++stat)
+    {
+        m_mean[stat * m_capacity + newSlot] = mean[stat];
+        m_min[stat * m_capacity + newSlot] = min[stat];
+        m_max[stat * m_capacity + newSlot] = max[stat];
+    }
+    m_averageGenomeHistory[newSlot] = averageGenome;
+    m_randomGenomeHistory[newSlot] = randomGenome;
+    ++m_size;
+}
+
+
+//This adds one entry that covers the two oldest entries of the source level.
+//Both cover the same number of samples, so the mean of their means is the mean
+//of all of them.  The merged entry takes the time and history organisms of the
+//earlier entry, matching what was kept when the log was halved.
+void StatsLogLevel::addMergeOfOldestTwo(const StatsLogLevel & source)
+{
+    double mean[LOGGED_STAT_COUNT];
+    double min[LOGGED_STAT_COUNT];
+    double max[LOGGED_STAT_COUNT];
+    for (int stat = 0; stat < LOGGED_STAT_COUNT; ++stat)
+    {
+        GraphData graphData = GraphData(stat);
+        mean[stat] = (source.getMean(graphData, 0) + source.getMean(graphData, 1)) / 2.0;
+        min[stat] = std::min(source.getMin(graphData, 0), source.getMin(graphData, 1));
+        max[stat] = std::max(source.getMax(graphData, 0), source.getMax(graphData, 1));
+    }
+    add(source.getTime(0), mean, min, max,
+        source.getHistoryRecord(AVERAGE_GENOME, 0), source.getHistoryRecord(RANDOM_ORGANISM, 0));
+}
+
+
+void StatsLogLevel::removeOldest(int count)
+{
+    //The history records are cleared so their genomes are freed now, not when
+    //the slots are next reused.
+    for (int i = 0; i < count; ++i)
+    {
+        m_averageGenomeHistory[slot(i)] = HistoryRecord();
+        m_randomGenomeHistory[slot(i)] = HistoryRecord();
+    }
+    m_first = slot(count);
+    m_size -= count;
+}
+
+
+void StatsLogLevel::getHistory(std::vector<HistoryRecord> * averageGenomeHistory,
+                               std::vector<HistoryRecord> * randomGenomeHistory) const
+{
+    *averageGenomeHistory = m_averageGenomeHistory;
+    *randomGenomeHistory = m_randomGenomeHistory;
+}
+
+//The history is only taken if it has a record for each slot, so a damaged
+//history section leaves the records empty rather than out of range.
+void StatsLogLevel::swapHistory(std::vector<HistoryRecord> * averageGenomeHistory,
+                                std::vector<HistoryRecord> * randomGenomeHistory)
+{
+    if (int(averageGenomeHistory->size()) != m_capacity || int(randomGenomeHistory->size()) != m_capacity)
+        return;
+    m_averageGenomeHistory.swap(*averageGenomeHistory);
+    m_randomGenomeHistory.swap(*randomGenomeHistory);
+}
+
+
+
+
+void StatsLog::add(double time, const double * values,
+                   const HistoryRecord & averageGenome, const HistoryRecord & randomGenome)
+{
+    makeRoom(0);
+    m_levels[0].add(time, values, values, values, averageGenome, randomGenome);
+}
+
+
+//This makes sure the given level has a free slot, by merging its two oldest
+//entries into the level above.  That level may need room made first, and is
+//created if it doesn't exist yet.
+void StatsLog::makeRoom(size_t level)
+{
+    if (level == m_levels.size())
+        m_levels.push_back(StatsLogLevel(std::max(2, g_simulationSettings->logEntriesPerLevel)));
+    if (!m_levels[level].isFull())
+        return;
+
+    makeRoom(level + 1);
+    m_levels[level + 1].addMergeOfOldestTwo(m_levels[level]);
+    m_levels[level].removeOldest(2);
+}
+
+
+int StatsLog::size() const
+{
+    int total = 0;
+    for (size_t i = 0; i < m_levels.size(); ++i)
+        total += m_levels[i].size();
+    return total;
+}
+
+
+//This finds the level holding the entry with the given chronological index and
+//changes the index to be the entry's index within that level.
+const StatsLogLevel & StatsLog::findEntry(int * index) const
+{
+    for (size_t level = m_levels.size() - 1; level > 0; --level)
+    {
+        if (*index < m_levels[level].size())
+            return m_levels[level];
+        *index -= m_levels[level].size();
+    }
+    return m_levels[0];
+}
+
+double StatsLog::getTime(int index) const
+{
+    const StatsLogLevel & level = findEntry(&index);
+    return level.getTime(index);
+}
+double StatsLog::getMean(GraphData stat, int index) const
+{
+    const StatsLogLevel & level = findEntry(&index);
+    return level.getMean(stat, index);
+}
+double StatsLog::getMin(GraphData stat, int index) const
+{
+    const StatsLogLevel & level = findEntry(&index);
+    return level.getMin(stat, index);
+}
+double StatsLog::getMax(GraphData stat, int index) const
+{
+    const StatsLogLevel & level = findEntry(&index);
+    return level.getMax(stat, index);
+}
+const HistoryRecord & StatsLog::getHistoryRecord(HistoryOrganismType historyOrganismType, int index) const
+{
+    const StatsLogLevel & level = findEntry(&index);
+    return level.getHistoryRecord(historyOrganismType, index);
+}
+
+
+//Entry times only increase, so this is a binary search.  It returns -1 if the
+//log is empty.
+int StatsLog::getIndexNearestToTime(double time) const
+{
+    int entryCount = size();
+    if (entryCount == 0)
+        return -1;
+
+    int low = 0;
+    int high = entryCount - 1;
+    while (low < high)
+    {
+        int middle = (low + high) / 2;
+        if (getTime(middle) < time)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    if (low > 0 && time - getTime(low - 1) < getTime(low) - time)
+        return low - 1;
+    return low;
+}
+
+
+void StatsLog::getHistory(StatsLogHistory * history) const
+{
+    history->m_averageGenomeHistory.resize(m_levels.size());
+    history->m_randomGenomeHistory.resize(m_levels.size());
+    for (size_t i = 0; i < m_levels.size(); ++i)
+        m_levels[i].getHistory(&history->m_averageGenomeHistory[i], &history->m_randomGenomeHistory[i]);
+}
+
+//The history records are moved out of the given history into the levels they
+//belong to.
+void StatsLog::setHistory(StatsLogHistory * history)
+{
+    for (size_t i = 0; i < m_levels.size() && i < history->m_averageGenomeHistory.size() &&
+         i < history->m_randomGenomeHistory.size(); ++i)
+        m_levels[i].swapHistory(&history->m_averageGenomeHistory[i], &history->m_randomGenomeHistory[i]);
+}
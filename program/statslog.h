@@ -0,0 +1,195 @@
+//Copyright 2015 Ryan Wick
+
+//This file is part of Grovolve.
+
+//Grovolve is free software: you can redistribute it and/or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+
+//Grovolve is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with Grovolve.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef STATSLOG_H
+#define STATSLOG_H
+
+#include <vector>
+#include "globals.h"
+#include "../plant/genome.h"
+
+#ifndef Q_MOC_RUN
+#include "boost/serialization/vector.hpp"
+#include "boost/shared_ptr.hpp"
+#include "boost/serialization/shared_ptr.hpp"
+#endif // Q_MOC_RUN
+namespace boost {namespace serialization {class access;}}
+
+class Organism;
+
+//The log has one column for each GraphData value, in the same order.
+const int LOGGED_STAT_COUNT = ENERGY_PER_SEED + 1;
+
+
+//One entry in the genome history: the genome and generation of an organism
+//from the population at that time.  The genome is null if the population was
+//empty.  The organism itself isn't kept, as its plant part tree is much larger
+//than its genome - it is grown again when it is displayed.  The drawn extents
+//of the grown organism are kept so the history view can be sized without
+//growing every organism.
+class HistoryRecord
+{
+public:
+    HistoryRecord() :
+        m_generation(0.0), m_highestDrawnPoint(0.0), m_rightmostDrawnPoint(0.0), m_leftmostDrawnPoint(0.0) {}
+    HistoryRecord(boost::shared_ptr<Genome> genome, double generation, const Organism * grownOrganism);
+
+    boost::shared_ptr<Genome> m_genome;
+    double m_generation;
+    double m_highestDrawnPoint;
+    double m_rightmostDrawnPoint;
+    double m_leftmostDrawnPoint;
+
+    bool isEmpty() const {return m_genome.get() == 0;}
+
+private:
+    friend class boost::serialization::access;
+    template<typename Archive>
+    void serialize(Archive & ar, const unsigned)
+    {
+        ar & m_genome;
+        ar & m_generation;
+        ar & m_highestDrawnPoint;
+        ar & m_rightmostDrawnPoint;
+        ar & m_leftmostDrawnPoint;
+
+        if (!isEmpty())
+            ++g_historyOrganismsSavedOrLoaded;
+    }
+};
+
+
+//One resolution of the stats log: a fixed-size ring buffer of entries, each
+//covering the same number of logged samples.  Values are stored by column, with
+//the mean, min and max of each stat over the samples an entry covers.
+class StatsLogLevel
+{
+public:
+    StatsLogLevel() : m_capacity(0), m_first(0), m_size(0) {}
+    explicit StatsLogLevel(int capacity);
+
+    int size() const {return m_size;}
+    bool isFull() const {return m_size == m_capacity;}
+    double getTime(int index) const {return m_time[slot(index)];}
+    double getMean(GraphData stat, int index) const {return m_mean[column(stat, index)];}
+    double getMin(GraphData stat, int index) const {return m_min[column(stat, index)];}
+    double getMax(GraphData stat, int index) const {return m_max[column(stat, index)];}
+    const HistoryRecord & getHistoryRecord(HistoryOrganismType historyOrganismType, int index) const;
+
+    void add(double time, const double * mean, const double * min, const double * max,
+             const HistoryRecord & averageGenome, const HistoryRecord & randomGenome);
+    void addMergeOfOldestTwo(const StatsLogLevel & source);
+    void removeOldest(int count);
+    void getHistory(std::vector<HistoryRecord> * averageGenomeHistory,
+                    std::vector<HistoryRecord> * randomGenomeHistory) const;
+    void swapHistory(std::vector<HistoryRecord> * averageGenomeHistory,
+                     std::vector<HistoryRecord> * randomGenomeHistory);
+
+private:
+    int m_capacity;
+    int m_first;
+    int m_size;
+    std::vector<double> m_time;
+    std::vector<double> m_mean;
+    std::vector<double> m_min;
+    std::vector<double> m_max;
+    std::vector<HistoryRecord> m_averageGenomeHistory;
+    std::vector<HistoryRecord> m_randomGenomeHistory;
+
+    int slot(int index) const {return (m_first + index) % m_capacity;}
+    int column(GraphData stat, int index) const {return stat * m_capacity + slot(index);}
+
+    //The history records are saved separately, through StatsLogHistory, and
+    //are left empty here until they are loaded.
+    friend class boost::serialization::access;
+    template<typename Archive>
+    void serialize(Archive & ar, const unsigned)
+    {
+        ar & m_capacity;
+        ar & m_first;
+        ar & m_size;
+        ar & m_time;
+        ar & m_mean;
+        ar & m_min;
+        ar & m_max;
+        if (Archive::is_loading::value)
+        {
+            m_averageGenomeHistory.assign(m_capacity, HistoryRecord());
+            m_randomGenomeHistory.assign(m_capacity, HistoryRecord());
+        }
+    }
+};
+
+
+//The history records of every log level, by slot.  They hold most of the
+//logged data, so they are saved in their own section of a save file and can
+//be loaded after the rest of the simulation.
+struct StatsLogHistory
+{
+    std::vector<std::vector<HistoryRecord> > m_averageGenomeHistory;
+    std::vector<std::vector<HistoryRecord> > m_randomGenomeHistory;
+
+    template<typename Archive>
+    void serialize(Archive & ar, const unsigned)
+    {
+        ar & m_averageGenomeHistory;
+        ar & m_randomGenomeHistory;
+    }
+};
+
+
+//This holds the logged stats at several resolutions.  Level 0 has the most
+//recent samples at the full logging rate.  When a level is full, its two oldest
+//entries are merged into one entry on the next level, so each level covers
+//twice as much time per entry as the one below it.  The recent past therefore
+//stays at full resolution while memory only grows with the logarithm of the
+//run length.  As the levels are ring buffers, merging moves no other entries.
+//Entries are numbered from the oldest (in the highest level) to the newest.
+class StatsLog
+{
+public:
+    StatsLog() {}
+
+    void clear() {m_levels.clear();}
+    void add(double time, const double * values,
+             const HistoryRecord & averageGenome, const HistoryRecord & randomGenome);
+    int size() const;
+    double getTime(int index) const;
+    double getMean(GraphData stat, int index) const;
+    double getMin(GraphData stat, int index) const;
+    double getMax(GraphData stat, int index) const;
+    const HistoryRecord & getHistoryRecord(HistoryOrganismType historyOrganismType, int index) const;
+    int getIndexNearestToTime(double time) const;
+    void getHistory(StatsLogHistory * history) const;
+    void setHistory(StatsLogHistory * history);
+
+private:
+    std::vector<StatsLogLevel> m_levels;
+
+    void makeRoom(size_t level);
+    const StatsLogLevel & findEntry(int * index) const;
+
+    friend class boost::serialization::access;
+    template<typename Archive>
+    void serialize(Archive & ar, const unsigned)
+    {
+        ar & m_levels;
+    }
+};
+
+#endif // STATSLOG_H
@@ -0,0 +1,163 @@
+//Copyright 2015 Ryan Wick
+
+//This file is part of Grovolve.
+
+//Grovolve is free software: you can redistribute it and/or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+
+//Grovolve is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with Grovolve.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include "statslogfile.h"
+#include <cstring>
+
+//This starts a new, empty log file.  Any existing file with the same name is
+//replaced.
+bool StatsLogFile::open(QString fileName)
+{
+    m_file.close();
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    char header[STATS_LOG_FILE_HEADER_SIZE];
+    qint32 version = STATS_LOG_FILE_VERSION;
+    qint32 columns = STATS_LOG_FILE_COLUMNS;
+    memcpy(header, STATS_LOG_FILE_MAGIC, 8);
+    memcpy(header + 8, &version, 4);
+    memcpy(header + 12, &columns, 4);
+    m_file.write(header, STATS_LOG_FILE_HEADER_SIZE);
+    m_file.flush();
+    return true;
+}
+
+
+//This carries on writing an existing log file.  The records up to and including
+//the given time are kept and any after it are removed, so a file written
+//before a save was loaded only loses the samples the loaded simulation hasn't
+//reached yet.  If the file doesn't have a matching header, a new one is
+//started.  lastKeptTime is set to the time of the last record kept, or -1.0 if
+//there are none (simulation times are never negative).
+bool StatsLogFile::reopen(QString fileName, double time, double * lastKeptTime)
+{
+    *lastKeptTime = -1.0;
+    m_file.close();
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadWrite))
+        return false;
+
+    char header[STATS_LOG_FILE_HEADER_SIZE];
+    qint32 version, columns;
+    if (m_file.read(header, STATS_LOG_FILE_HEADER_SIZE) != STATS_LOG_FILE_HEADER_SIZE)
+        return open(fileName);
+    memcpy(&version, header + 8, 4);
+    memcpy(&columns, header + 12, 4);
+    if (memcmp(header, STATS_LOG_FILE_MAGIC, 8) != 0 ||
+            version != STATS_LOG_FILE_VERSION || columns != STATS_LOG_FILE_COLUMNS)
+        return open(fileName);
+
+    //The records are in time order, so the first one past the given time is
+    //found with a binary search.  A partly written record at the end is
+    //dropped too.
+    qint64 records = (m_file.size() - STATS_LOG_FILE_HEADER_SIZE) / STATS_LOG_FILE_RECORD_SIZE;
+    qint64 low = 0;
+    qint64 high = records;
+    while (low < high)
+    {
+        qint64 middle = low + (high - low) / 2;
+        double recordTime;
+        m_file.seek(STATS_LOG_FILE_HEADER_SIZE + middle * STATS_LOG_FILE_RECORD_SIZE);
+        if (m_file.read(reinterpret_cast<char *>(&recordTime), sizeof(double)) != qint64(sizeof(double)))
+            return open(fileName);
+        if (recordTime <= time)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    qint64 keptSize = STATS_LOG_FILE_HEADER_SIZE + low * STATS_LOG_FILE_RECORD_SIZE;
+    if (low > 0)
+    {
+        m_file.seek(keptSize - STATS_LOG_FILE_RECORD_SIZE);
+        if (m_file.read(reinterpret_cast<char *>(lastKeptTime), sizeof(double)) != qint64(sizeof(double)))
+            return open(fileName);
+    }
+    if (!m_file.resize(keptSize) || !m_file.seek(keptSize))
+        return open(fileName);
+    return true;
+}
+
+
+//The file is flushed after each record so readers always see whole samples.
+void StatsLogFile::append(double time, const double * values)
+{
+    if (!m_file.isOpen())
+        return;
+
+    double record[STATS_LOG_FILE_COLUMNS];
+    record[0] = time;
+    memcpy(record + 1, values, LOGGED_STAT_COUNT * sizeof(double));
+    m_file.write(reinterpret_cast<const char *>(record), STATS_LOG_FILE_RECORD_SIZE);
+    m_file.flush();
+}
+
+
+
+
+StatsLogFileMap::StatsLogFileMap(QString fileName) :
+    m_file(fileName), m_map(0), m_records(0), m_size(0)
+{
+    if (m_file.open(QIODevice::ReadOnly))
+        mapFile();
+}
+
+StatsLogFileMap::~StatsLogFileMap()
+{
+    if (m_map != 0)
+        m_file.unmap(m_map);
+}
+
+
+//The file is mapped again, so samples appended since it was last mapped can be
+//read.
+void StatsLogFileMap::refresh()
+{
+    if (m_map != 0)
+        m_file.unmap(m_map);
+    m_map = 0;
+    m_records = 0;
+    m_size = 0;
+
+    if (m_file.isOpen())
+        mapFile();
+}
+
+
+void StatsLogFileMap::mapFile()
+{
+    qint64 fileSize = m_file.size();
+    if (fileSize < STATS_LOG_FILE_HEADER_SIZE)
+        return;
+    m_map = m_file.map(0, fileSize);
+    if (m_map == 0)
+        return;
+
+    qint32 version, columns;
+    memcpy(&version, m_map + 8, 4);
+    memcpy(&columns, m_map + 12, 4);
+    if (memcmp(m_map, STATS_LOG_FILE_MAGIC, 8) != 0 ||
+            version != STATS_LOG_FILE_VERSION || columns != STATS_LOG_FILE_COLUMNS)
+        return;
+
+    //A record that is still being written is left out.
+    m_size = int((fileSize - STATS_LOG_FILE_HEADER_SIZE) / STATS_LOG_FILE_RECORD_SIZE);
+    m_records = reinterpret_cast<const double *>(m_map + STATS_LOG_FILE_HEADER_SIZE);
+}
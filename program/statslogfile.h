@@ -0,0 +1,82 @@
+//Copyright 2015 Ryan Wick
+
+//This file is part of Grovolve.
+
+//Grovolve is free software: you can redistribute it and/or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+
+//Grovolve is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with Grovolve.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef STATSLOGFILE_H
+#define STATSLOGFILE_H
+
+#include <QFile>
+#include <QString>
+#include "globals.h"
+#include "statslog.h"
+
+//The stats log file keeps every logged sample at full resolution, so the
+//in-memory log can stay small.  It is only appended to while the simulation
+//runs, so it can be read at the same time, including by other programs.  When
+//a save is loaded, the records after the loaded time are cut off.
+//The file starts with a 16 byte header: the 8 characters "GROVSTAT", then the
+//format version and the number of columns as 32-bit integers.  Each sample is
+//then one record of doubles: the time followed by one value for each GraphData.
+//All numbers are in the byte order of the machine that wrote the file.
+const char STATS_LOG_FILE_MAGIC[] = "GROVSTAT";
+const qint32 STATS_LOG_FILE_VERSION = 1;
+const int STATS_LOG_FILE_COLUMNS = LOGGED_STAT_COUNT + 1;
+const int STATS_LOG_FILE_HEADER_SIZE = 16;
+const int STATS_LOG_FILE_RECORD_SIZE = STATS_LOG_FILE_COLUMNS * sizeof(double);
+
+class StatsLogFile
+{
+public:
+    StatsLogFile() {}
+
+    bool open(QString fileName);
+    bool reopen(QString fileName, double time, double * lastKeptTime);
+    void close() {m_file.close();}
+    bool isOpen() const {return m_file.isOpen();}
+    QString getFileName() const {return m_file.fileName();}
+    void append(double time, const double * values);
+
+private:
+    QFile m_file;
+};
+
+
+//This reads a stats log file through a memory map, so only the parts of the
+//file that are used are paged in.  It sees the samples that were in the file
+//when it was made or last refreshed.
+class StatsLogFileMap
+{
+public:
+    StatsLogFileMap(QString fileName);
+    ~StatsLogFileMap();
+
+    bool isValid() const {return m_records != 0;}
+    int size() const {return m_size;}
+    double getTime(int index) const {return m_records[index * STATS_LOG_FILE_COLUMNS];}
+    double getValue(GraphData stat, int index) const {return m_records[index * STATS_LOG_FILE_COLUMNS + 1 + stat];}
+    void refresh();
+
+private:
+    QFile m_file;
+    uchar * m_map;
+    const double * m_records;
+    int m_size;
+
+    void mapFile();
+};
+
+#endif // STATSLOGFILE_H
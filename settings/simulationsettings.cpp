@@ -35,6 +35,8 @@ SimulationSettings::SimulationSettings()
     minimumGrowthRate = 1.0;
     growthRandomness = 0.02;
     maxPlantPartsPerOrganism = 1000;
+    organismsPerTask = 64;
+    historyOrganismCacheSize = 50;
     randomDeathRate = 0.0005;
 
     //Details for helped organisms.
@@ -125,7 +127,7 @@ SimulationSettings::SimulationSettings()
 
     //Logging settings
     statLoggingInterval = 1000;
-    maxLogEntries = 1000;
+    logEntriesPerLevel = 500;
     minGraphSpan = 100000.0;
     minNucleotideGraphSpan = 25;
     autoImageSave = false;
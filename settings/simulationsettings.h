@@ -77,6 +77,8 @@ public:
     double minimumPlantPartLength; //Sets the minimum for the FINAL length of a PlantPart - the starting length can still be zero.
     double minimumGrowthRate;
     int maxPlantPartsPerOrganism;
+    int organismsPerTask; //Organisms are split into blocks of this size for parallel work that draws random numbers.  Changing it changes the random outcome.
+    int historyOrganismCacheSize; //How many history organisms are kept grown for display.  The rest are regrown from their genomes when needed.
     double sunriseAngle;
     double sunsetAngle;
     double torqueScalingFactor;
@@ -109,7 +111,7 @@ public:
     double maxZoom;
     double zoomStep;
     int statLoggingInterval;
-    int maxLogEntries;
+    int logEntriesPerLevel; //How many entries each resolution level of the stats log holds before its oldest entries are merged into the next level.
     double minGraphSpan;
     double minNucleotideGraphSpan;
     bool autoImageSave;
@@ -0,0 +1,95 @@
+//Copyright 2015 Ryan Wick
+
+//This file is part of Grovolve.
+
+//Grovolve is free software: you can redistribute it and/or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+
+//Grovolve is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with Grovolve.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "ticksettings.h"
+#include "simulationsettings.h"
+#include "environmentsettings.h"
+
+TickSettings::TickSettings(const TickSettings * previousTick) :
+    organismMaintenanceCost(g_simulationSettings->organismMaintenanceCost),
+    plantPartMaintenanceCost(g_simulationSettings->plantPartMaintenanceCost),
+    leafMaintenanceCost(g_simulationSettings->leafMaintenanceCost),
+    branchMaintenanceCost(g_simulationSettings->branchMaintenanceCost),
+    seedpodMaintenanceCost(g_simulationSettings->seedpodMaintenanceCost),
+    leafGrowthCost(g_simulationSettings->leafGrowthCost),
+    branchGrowthCost(g_simulationSettings->branchGrowthCost),
+    seedpodGrowthCost(g_simulationSettings->seedpodGrowthCost),
+    seedCreationCost(g_simulationSettings->seedCreationCost),
+    leafDensity(g_simulationSettings->leafDensity),
+    branchDensity(g_simulationSettings->branchDensity),
+    seedpodDensity(g_simulationSettings->seedpodDensity),
+    branchStrengthFactor(g_simulationSettings->branchStrengthFactor),
+    branchStrengthScalingPower(g_simulationSettings->branchStrengthScalingPower),
+    branchWidthGrowthIncrement(g_simulationSettings->branchWidthGrowthIncrement),
+    torqueScalingFactor(g_simulationSettings->torqueScalingFactor),
+    newSeedsPerTickPerSeedpod(g_simulationSettings->newSeedsPerTickPerSeedpod),
+    growRateGeneRatio(g_simulationSettings->growRateGeneRatio),
+    minimumGrowthRate(g_simulationSettings->minimumGrowthRate),
+    leafLength(g_simulationSettings->leafLength),
+    minimumPlantPartLength(g_simulationSettings->minimumPlantPartLength),
+    seedpodLengthScale(g_simulationSettings->seedpodLengthScale),
+    promoterLength(g_simulationSettings->promoterLength),
+    maxChildrenPerBranch(g_simulationSettings->maxChildrenPerBranch),
+    maxPlantPartsPerOrganism(g_simulationSettings->maxPlantPartsPerOrganism),
+    allowLoops(g_simulationSettings->allowLoops),
+    gravity(g_environmentSettings->m_currentValues.m_gravity),
+    generation(getGeneration(previousTick))
+{
+}
+
+
+//This is called while the generation is being initialised, so it only uses the
+//values declared before it.
+int TickSettings::getGeneration(const TickSettings * previousTick) const
+{
+    if (previousTick == 0)
+        return 0;
+    if (hasSameValues(*previousTick))
+        return previousTick->generation;
+    return previousTick->generation + 1;
+}
+
+bool TickSettings::hasSameValues(const TickSettings & other) const
+{
+    return organismMaintenanceCost == other.organismMaintenanceCost &&
+            plantPartMaintenanceCost == other.plantPartMaintenanceCost &&
+            leafMaintenanceCost == other.leafMaintenanceCost &&
+            branchMaintenanceCost == other.branchMaintenanceCost &&
+            seedpodMaintenanceCost == other.seedpodMaintenanceCost &&
+            leafGrowthCost == other.leafGrowthCost &&
+            branchGrowthCost == other.branchGrowthCost &&
+            seedpodGrowthCost == other.seedpodGrowthCost &&
+            seedCreationCost == other.seedCreationCost &&
+            leafDensity == other.leafDensity &&
+            branchDensity == other.branchDensity &&
+            seedpodDensity == other.seedpodDensity &&
+            branchStrengthFactor == other.branchStrengthFactor &&
+            branchStrengthScalingPower == other.branchStrengthScalingPower &&
+            branchWidthGrowthIncrement == other.branchWidthGrowthIncrement &&
+            torqueScalingFactor == other.torqueScalingFactor &&
+            newSeedsPerTickPerSeedpod == other.newSeedsPerTickPerSeedpod &&
+            growRateGeneRatio == other.growRateGeneRatio &&
+            minimumGrowthRate == other.minimumGrowthRate &&
+            leafLength == other.leafLength &&
+            minimumPlantPartLength == other.minimumPlantPartLength &&
+            seedpodLengthScale == other.seedpodLengthScale &&
+            promoterLength == other.promoterLength &&
+            maxChildrenPerBranch == other.maxChildrenPerBranch &&
+            maxPlantPartsPerOrganism == other.maxPlantPartsPerOrganism &&
+            allowLoops == other.allowLoops &&
+            gravity == other.gravity;
+}
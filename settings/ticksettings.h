@@ -0,0 +1,72 @@
+//Copyright 2015 Ryan Wick
+
+//This file is part of Grovolve.
+
+//Grovolve is free software: you can redistribute it and/or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+
+//Grovolve is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with Grovolve.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TICKSETTINGS_H
+#define TICKSETTINGS_H
+
+//This holds copies of the settings that organisms, plant parts and genomes use
+//every tick.  One is made at the start of each tick and passed down through the
+//growth, load, maintenance and seed code, so that code doesn't read the global
+//settings at all.  It is made per tick instead of per run because the user can
+//change settings and the environment can change gravity while a simulation is
+//running.
+class TickSettings
+{
+public:
+    TickSettings(const TickSettings * previousTick = 0);
+
+    const double organismMaintenanceCost;
+    const double plantPartMaintenanceCost;
+    const double leafMaintenanceCost;
+    const double branchMaintenanceCost;
+    const double seedpodMaintenanceCost;
+    const double leafGrowthCost;
+    const double branchGrowthCost;
+    const double seedpodGrowthCost;
+    const double seedCreationCost;
+    const double leafDensity;
+    const double branchDensity;
+    const double seedpodDensity;
+    const double branchStrengthFactor;
+    const double branchStrengthScalingPower;
+    const double branchWidthGrowthIncrement;
+    const double torqueScalingFactor;
+    const double newSeedsPerTickPerSeedpod;
+    const double growRateGeneRatio;
+    const double minimumGrowthRate;
+    const double leafLength;
+    const double minimumPlantPartLength;
+    const double seedpodLengthScale;
+    const int promoterLength;
+    const int maxChildrenPerBranch;
+    const int maxPlantPartsPerOrganism;
+    const bool allowLoops;
+    const double gravity;
+
+    //This goes up by one whenever any of the values above differ from the
+    //previous tick's, so values worked out from the settings can be kept until
+    //it changes.
+    const int generation;
+
+    int getBranchGeneLength() const {return 14 + promoterLength * maxChildrenPerBranch;}
+
+private:
+    int getGeneration(const TickSettings * previousTick) const;
+    bool hasSameValues(const TickSettings & other) const;
+};
+
+#endif // TICKSETTINGS_H
@@ -0,0 +1,40 @@
+//Copyright 2015 Ryan Wick
+
+//This file is part of Grovolve.
+
+//Grovolve is free software: you can redistribute it and/or modify
+//it under the terms of the GNU General Public License as published by
+//the Free Software Foundation, either version 3 of the License, or
+//(at your option) any later version.
+
+//Grovolve is distributed in the hope that it will be useful,
+//but WITHOUT ANY WARRANTY; without even the implied warranty of
+//MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//GNU General Public License for more details.
+
+//You should have received a copy of the GNU General Public License
+//along with Grovolve.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef HISTORYTIMESPINBOX_H
+#define HISTORYTIMESPINBOX_H
+
+#include <QObject>
+#include <QSpinBox>
+
+//Log entries aren't evenly spaced in time, so no single step size moves
+//between them.  Instead, the arrows and keys ask for the entry a number of
+//steps away and leave it to the dialog to set the value.
+class HistoryTimeSpinBox : public QSpinBox
+{
+    Q_OBJECT
+public:
+    HistoryTimeSpinBox(QWidget * parent = 0);
+
+    void stepBy(int steps);
+
+signals:
+    void stepRequested(int steps);
+};
+
+#endif // HISTORYTIMESPINBOX_H
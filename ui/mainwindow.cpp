@@ -68,9 +68,11 @@ MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MainWindow),
     m_lastDisplayedEnvironmentInfoTab(0), m_lastDisplayedEnvironmentInfoGraph(0),
-    m_lastDisplayedEnvironmentInfoHistoryType(0), m_lastDisplayedLogScale(false), m_resumeSimulationAfterSave(false),
+    m_lastDisplayedEnvironmentInfoHistoryType(0), m_lastDisplayedLogScale(false), m_statsAndHistoryDialog(0),
+    m_resumeSimulationAfterSave(false),
     m_justSaved(false),
-    m_autosavePath(QDir::temp().path() + "/Grovolve-" + QString::number(QCoreApplication::applicationPid()) + ".grov")
+    m_autosavePath(QDir::temp().path() + "/Grovolve-" + QString::number(QCoreApplication::applicationPid()) + ".grov"),
+    m_autosaveThread(0)
 {
     tbb::task_scheduler_init init(tbb::task_scheduler_init::automatic);
 
@@ -134,6 +136,7 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->actionAutomatically_save_images, SIGNAL(triggered()), this, SLOT(openAutoSaveImagesDialog()));
     connect(ui->actionExit, SIGNAL(triggered()), this, SLOT(close()));
     connect(ui->actionRecover_autosave_files, SIGNAL(triggered()), this, SLOT(openRecoverFilesDialog()));
+    connect(ui->actionWrite_stats_log_file, SIGNAL(triggered(bool)), this, SLOT(toggleStatsLogFile(bool)));
     connect(m_environmentWidget, SIGNAL(mouseDrag(QPoint)), this, SLOT(mouseDrag(QPoint)));
     connect(ui->speedSlider, SIGNAL(valueChanged(int)), this, SLOT(simulationSpeedChanged()));
     connect(ui->scrollArea, SIGNAL(changed()), this, SLOT(scrollAreaChanged()));
@@ -335,6 +338,38 @@ void MainWindow::openRecoverFilesDialog()
         startSimulation();
 }
 
+
+//When turned on, the user chooses where the stats log file goes.  It starts
+//with the stats logged so far and then grows with each new log entry.
+void MainWindow::toggleStatsLogFile(bool on)
+{
+    if (!on)
+    {
+        closeStatsAndHistoryDialog();
+        g_stats->closeLogFile();
+        return;
+    }
+
+    bool simulationRunningAtFunctionStart = simulationIsRunning();
+    stopSimulation();
+    closeStatsAndHistoryDialog();
+
+    QString defaultFileNameAndPath = g_simulationSettings->rememberedPath + "/" + m_environment->getDateAndTimeOfSimStart() + ".grovstats";
+    QString fullFileName = QFileDialog::getSaveFileName(this, "Write stats log file", defaultFileNameAndPath, "Grovolve stats log (*.grovstats)");
+
+    if (fullFileName != "") //User did not hit cancel
+    {
+        g_simulationSettings->rememberPath(fullFileName);
+        if (!g_stats->openLogFile(fullFileName))
+            QMessageBox::critical(this, "Error writing file", "An error was encountered while\n"
+                                                              "attempting to write to file.");
+    }
+    ui->actionWrite_stats_log_file->setChecked(g_stats->getLogFileName() != "");
+
+    if (simulationRunningAtFunctionStart)
+        startSimulation();
+}
+
 void MainWindow::openQuickSummaryDialog()
 {
     bool simulationRunningAtFunctionStart = simulationIsRunning();
@@ -375,27 +410,49 @@ void MainWindow::openOrganismInfoDialog(const Organism * organism)
 
 
 
+//The dialog isn't modal, so it can stay open while the simulation runs.  It is
+//given new log entries from advanceOneTick.
 void MainWindow::openStatsAndHistoryDialog()
 {
-    bool simulationRunningAtFunctionStart = simulationIsRunning();
-    stopSimulation();
+    if (m_statsAndHistoryDialog != 0)
+    {
+        m_statsAndHistoryDialog->raise();
+        m_statsAndHistoryDialog->activateWindow();
+        return;
+    }
 
-    StatsAndHistoryDialog environmentInfoDialog(this, m_environment);
+    g_stats->finishPendingLog();
 
-    environmentInfoDialog.setDisplayedTab(m_lastDisplayedEnvironmentInfoTab);
-    environmentInfoDialog.setDisplayedGraph(m_lastDisplayedEnvironmentInfoGraph);
-    environmentInfoDialog.setLogScale(m_lastDisplayedLogScale);
-    environmentInfoDialog.setHistoryType(m_lastDisplayedEnvironmentInfoHistoryType);
+    m_statsAndHistoryDialog = new StatsAndHistoryDialog(this, m_environment);
 
-    environmentInfoDialog.exec();
+    m_statsAndHistoryDialog->setDisplayedTab(m_lastDisplayedEnvironmentInfoTab);
+    m_statsAndHistoryDialog->setDisplayedGraph(m_lastDisplayedEnvironmentInfoGraph);
+    m_statsAndHistoryDialog->setLogScale(m_lastDisplayedLogScale);
+    m_statsAndHistoryDialog->setHistoryType(m_lastDisplayedEnvironmentInfoHistoryType);
 
-    m_lastDisplayedEnvironmentInfoTab = environmentInfoDialog.getDisplayedTab();
-    m_lastDisplayedEnvironmentInfoGraph = environmentInfoDialog.getDisplayedGraph();
-    m_lastDisplayedLogScale = environmentInfoDialog.getLogScale();
-    m_lastDisplayedEnvironmentInfoHistoryType = environmentInfoDialog.getHistoryType();
+    connect(m_statsAndHistoryDialog, SIGNAL(finished(int)), this, SLOT(statsAndHistoryDialogClosed()));
+    m_statsAndHistoryDialog->show();
+}
 
-    if (simulationRunningAtFunctionStart)
-        startSimulation();
+
+void MainWindow::statsAndHistoryDialogClosed()
+{
+    m_lastDisplayedEnvironmentInfoTab = m_statsAndHistoryDialog->getDisplayedTab();
+    m_lastDisplayedEnvironmentInfoGraph = m_statsAndHistoryDialog->getDisplayedGraph();
+    m_lastDisplayedLogScale = m_statsAndHistoryDialog->getLogScale();
+    m_lastDisplayedEnvironmentInfoHistoryType = m_statsAndHistoryDialog->getHistoryType();
+
+    m_statsAndHistoryDialog->deleteLater();
+    m_statsAndHistoryDialog = 0;
+}
+
+
+//The dialog must be closed before the logged data is replaced, as it reads
+//the log (and the log file) directly.
+void MainWindow::closeStatsAndHistoryDialog()
+{
+    if (m_statsAndHistoryDialog != 0)
+        m_statsAndHistoryDialog->reject();
 }
 
 
@@ -483,6 +540,21 @@ void MainWindow::advanceOneTick()
 
     updateTimeDisplay();
 
+    //If the stats dialog is open, it is given any finished log entries.  This
+    //doesn't wait for an entry that is still being made.
+    if (m_statsAndHistoryDialog != 0)
+    {
+        g_stats->finishPendingLogIfReady();
+        m_statsAndHistoryDialog->addNewLogEntries();
+    }
+
+    //The history of a loaded simulation is read in the background, so if it
+    //couldn't be read, that is only found out now.
+    if (g_stats->takeHistoryLoadFailure())
+        QMessageBox::warning(this, "Error loading history", "The genome history could not be read from the\n"
+                                                            "save file, so it has been left empty.\n\n"
+                                                            "The rest of the simulation loaded correctly.");
+
     if (g_simulationSettings->cloudsOn)
         m_environmentWidget->moveClouds();
 }
@@ -526,6 +598,7 @@ void MainWindow::resetSimulation()
             return;
     }
 
+    closeStatsAndHistoryDialog();
     m_environment->reset();
 
     setEnvironmentSize();
@@ -707,6 +780,7 @@ void MainWindow::closeEvent(QCloseEvent * event)
             m_justSaved)
     {
         event->accept();
+        waitForAutosave();
         QFile::remove(m_autosavePath);
     }
 
@@ -724,6 +798,7 @@ void MainWindow::closeEvent(QCloseEvent * event)
     else
     {
         event->accept();
+        waitForAutosave();
         QFile::remove(m_autosavePath);
     }
 }
@@ -767,11 +842,46 @@ void MainWindow::saveSimulationManual()
 
 
 
+//Autosaves don't stop the simulation.  A snapshot is serialized into memory
+//between ticks (apart from the history, which is only copied) and then
+//archived, compressed and written on another thread while the simulation
+//carries on.  Only one autosave is written at a time: if the last
+//one is still being written, this one is skipped.
 void MainWindow::saveSimulationAutomatic()
 {
-    m_resumeSimulationAfterSave = true;
-    stopSimulation();
-    saveSimulation(m_autosavePath, true, "Autosaving...");
+    if (m_autosaveThread != 0)
+        return;
+
+    g_stats->finishPendingLog();
+    boost::shared_ptr<SaveFileSnapshot> snapshot = SaverAndLoader::makeSnapshot(m_environment, g_environmentSettings,
+                                                                                g_simulationSettings, g_stats);
+
+    m_autosaveThread = new QThread;
+    SaverAndLoader * saverAndLoader = new SaverAndLoader(m_autosavePath, snapshot);
+    saverAndLoader->moveToThread(m_autosaveThread);
+
+    connect(m_autosaveThread, SIGNAL(started()), saverAndLoader, SLOT(writeSnapshot()));
+    connect(saverAndLoader, SIGNAL(finishedSaving()), m_autosaveThread, SLOT(quit()));
+    connect(saverAndLoader, SIGNAL(finishedSaving()), saverAndLoader, SLOT(deleteLater()));
+    connect(m_autosaveThread, SIGNAL(finished()), this, SLOT(finishedAutosaving()));
+
+    m_autosaveThread->start();
+}
+
+
+void MainWindow::finishedAutosaving()
+{
+    m_autosaveThread->deleteLater();
+    m_autosaveThread = 0;
+}
+
+
+//Used before the autosave file is removed, so an autosave that is still being
+//written can't put it back.
+void MainWindow::waitForAutosave()
+{
+    if (m_autosaveThread != 0)
+        m_autosaveThread->wait();
 }
 
 
@@ -784,6 +894,9 @@ void MainWindow::saveSimulation(QString fullFileName, bool history, QString mess
     waitingDialog->setWindowModality(Qt::WindowModal);
     waitingDialog->show();
 
+    //The stats log must be complete before it is handed to the saving thread.
+    g_stats->finishPendingLog();
+
     QThread * thread = new QThread;
     SaverAndLoader * saverAndLoader = new SaverAndLoader(fullFileName, m_environment, g_environmentSettings,
                                                          g_simulationSettings, g_stats, history);
@@ -841,6 +954,7 @@ void MainWindow::loadSimulationPrompt()
 
 void MainWindow::loadSimulation(QString fullFileName)
 {
+    closeStatsAndHistoryDialog();
     m_environmentWidget->setVisible(false);
     ui->timeLabel2->setText("0");
     ui->controlsWidget->setEnabled(false);
@@ -849,6 +963,8 @@ void MainWindow::loadSimulation(QString fullFileName)
     waitingDialog->setWindowModality(Qt::WindowModal);
     waitingDialog->show();
 
+    g_stats->finishPendingLog();
+
     QThread * thread = new QThread;
     SaverAndLoader * saverAndLoader = new SaverAndLoader(fullFileName, m_environment, g_environmentSettings,
                                                          g_simulationSettings, g_stats);
@@ -867,8 +983,11 @@ void MainWindow::loadSimulation(QString fullFileName)
 
 void MainWindow::finishedLoading()
 {
+    g_stats->startLoadingHistory();
+    g_stats->restartLogFile();
+
     //If the save file has no history, reset some things and log the first stats now.
-    if (g_stats->m_time.size() == 0 && m_environment->getElapsedTime() == 0)
+    if (g_stats->logEntries() == 0 && m_environment->getElapsedTime() == 0)
     {
         m_environment->logStats();
         m_environment->resetTime();
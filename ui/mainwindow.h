@@ -33,6 +33,8 @@ class EnvironmentWidget;
 class Environment;
 class EnvironmentValues;
 class Organism;
+class StatsAndHistoryDialog;
+class QThread;
 
 namespace Ui {
 class MainWindow;
@@ -55,12 +57,14 @@ private:
     int m_lastDisplayedEnvironmentInfoGraph;
     int m_lastDisplayedEnvironmentInfoHistoryType;
     bool m_lastDisplayedLogScale;
+    StatsAndHistoryDialog * m_statsAndHistoryDialog; //Null when the dialog isn't open
 
     bool m_resumeSimulationAfterSave;
     long long m_saveImageToFileNextTime;
     long long m_saveImageToFileInterval;
     bool m_justSaved;
     QString m_autosavePath;
+    QThread * m_autosaveThread; //Null when no autosave is being written
 
     void saveImageToFileAutomatic();
     void saveImageToFile2(QString saveFileName, bool highQuality, bool shadows);
@@ -80,11 +84,13 @@ private:
 
 protected:
     void closeEvent(QCloseEvent * event);
+    void waitForAutosave();
 
 public slots:
     void changeZoomLevel(double newZoomLevel);
     void openOrganismInfoDialog(const Organism * organism);
     void finishedSaving();
+    void finishedAutosaving();
     void finishedLoading();
 
 private slots:
@@ -97,8 +103,11 @@ private slots:
     void openQuickSummaryDialog();
     void openAboutDialog();
     void openStatsAndHistoryDialog();
+    void statsAndHistoryDialogClosed();
+    void closeStatsAndHistoryDialog();
     void openAutoSaveImagesDialog();
     void openRecoverFilesDialog();
+    void toggleStatsLogFile(bool on);
     void switchBasicMode();
     void switchAdvancedMode();
     void switchBasicAdvancedMode();
@@ -27,58 +27,35 @@
 #include <QPen>
 #include <QFileDialog>
 #include <QFont>
+#include <math.h>
 
 StatsAndHistoryDialog::StatsAndHistoryDialog(QWidget * parent, const Environment * const environment) :
     QDialog(parent, Qt::WindowTitleHint | Qt::WindowCloseButtonHint),
-    ui(new Ui::StatsAndHistoryDialog), m_environment(environment)
+    ui(new Ui::StatsAndHistoryDialog), m_environment(environment), m_logFileMap(0),
+    m_addingNewLogEntries(false), m_latestLogTime(-1.0), m_shownHistoryType(-1),
+    m_historyHeightExtent(0.0), m_historyLeftExtent(0.0), m_historyRightExtent(0.0)
 {
     ui->setupUi(this);
 
+    //If the stats are being written to a log file, the graphs are drawn from it,
+    //as it has every sample at full resolution.
+    if (g_stats->getLogFileName() != "")
+    {
+        m_logFileMap = new StatsLogFileMap(g_stats->getLogFileName());
+        if (!m_logFileMap->isValid())
+        {
+            delete m_logFileMap;
+            m_logFileMap = 0;
+        }
+    }
+
     ui->currentPopulationTitle->setFont(g_largeFont);
     ui->accumulatedTotalsTitle->setFont(g_largeFont);
     ui->genomeTitle->setFont(g_largeFont);
     ui->organismTitle->setFont(g_largeFont);
     ui->graphDataComboBox->setFont(g_largeFont);
 
-    ui->organismCountLabel->setText(this->locale().toString(int(environment->getOrganismCount())));
-    ui->environmentWidthLabel->setText(this->locale().toString(int(environment->getWidth())));
-    ui->populationDensityLabel->setText(formatDoubleForDisplay(environment->getPopulationDensity(), 3, this->locale()));
-
-    ui->seedCountLabel->setText(this->locale().toString(int(environment->getSeedCount())));
-    ui->meanSeedsPerPlantLabel->setText(formatDoubleForDisplay(environment->getMeanSeedsPerPlant(), 1, this->locale()));
-
-    ui->organismsSproutedLabel->setText(this->locale().toString(g_stats->m_numberOfOrganismsSprouted));
-    ui->organismsStarvedLabel->setText(this->locale().toString(g_stats->m_numberOfOrganismsDiedFromStarvation));
-    ui->organismsDiedFromBadLuckLabel->setText(this->locale().toString(g_stats->m_numberOfOrganismsDiedFromBadLuck));
-    ui->seedsGeneratedLabel->setText(this->locale().toString(g_stats->m_numberOfSeedsGenerated));
-
-    ui->averageGenerationLabel->setText(formatDoubleForDisplay(environment->getAverageGeneration(), 1, this->locale()));
-
-    ui->tallestPlantLabel->setText(formatDoubleForDisplay(environment->getTallestPlantHeight(), 1, this->locale()));
-    ui->heaviestPlantLabel->setText(formatDoubleForDisplay(environment->getHeaviestPlantMass(), 1, this->locale()));
-
-    ui->meanEnergyPerSeedLabel->setText(formatDoubleForDisplay(environment->getAverageEnergyPerSeed(), 1, this->locale()));
-
-    int elapsedSeconds = environment->getElapsedRealWorldSeconds();
-    int elapsedMinutes = elapsedSeconds / 60;
-    elapsedSeconds %= 60;
-    int elapsedHours = elapsedMinutes / 60;
-    elapsedMinutes %= 60;
-    int elapsedDays = elapsedHours / 24;
-    elapsedHours %= 24;
-    QString elapsedTimeString;
-    if (elapsedDays > 1)
-        elapsedTimeString += QString::number(elapsedDays) + " days, ";
-    if (elapsedDays == 1)
-        elapsedTimeString += QString::number(elapsedDays) + " day, ";
-    if (elapsedHours > 1)
-        elapsedTimeString += QString::number(elapsedHours) + " hours, ";
-    else if (elapsedHours == 1)
-        elapsedTimeString += QString::number(elapsedHours) + " hour, ";
-    if (elapsedMinutes > 0)
-        elapsedTimeString += QString::number(elapsedMinutes) + " min, ";
-    elapsedTimeString += QString::number(elapsedSeconds) + " sec";
-    ui->realWorldTimeLabel->setText(elapsedTimeString);
+    setCurrentPopulationLabels();
 
     ui->organismTypeInfoText->setInfoText("The genome below can either be an average genome for the specified point "
                                           "in history or a randomly-chosen organism at that point in history.");
@@ -104,20 +81,11 @@ StatsAndHistoryDialog::StatsAndHistoryDialog(QWidget * parent, const Environment
     int maxSliderPosition = g_stats->logEntries() - 1;
     ui->genomeHistoryTimeSlider->setMaximum(maxSliderPosition);
     ui->genomeHistoryTimeSlider->setValue(maxSliderPosition);
-    m_sizeOfEachTick = g_simulationSettings->statLoggingInterval * environment->getLogIntervalMultiplier();
-    ui->genomeHistoryTimeSpinBox->setSingleStep(m_sizeOfEachTick);
     ui->genomeHistoryTimeSpinBox->setMinimum(0);
-    ui->genomeHistoryTimeSpinBox->setMaximum(maxSliderPosition * m_sizeOfEachTick);
-
-    if (maxSliderPosition == 0)
-    {
-        ui->genomeHistoryWidget->setEnabled(false);
-        ui->genomeHistoryTimeSlider->setEnabled(false);
-    }
-
-    genomeHistoryChanged();
-
+    setGenomeHistoryRange();
     setOrganismWidgetRange();
+    if (maxSliderPosition >= 0)
+        m_latestLogTime = g_stats->m_log.getTime(maxSliderPosition);
 
     resetGraphXRange();
 
@@ -133,6 +101,7 @@ StatsAndHistoryDialog::StatsAndHistoryDialog(QWidget * parent, const Environment
     connect(ui->historyTypeComboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(genomeHistoryChanged()));
     connect(ui->genomeHistoryTimeSpinBox, SIGNAL(valueChanged(int)), this, SLOT(genomeHistorySpinBoxChanged()));
     connect(ui->genomeHistoryTimeSpinBox, SIGNAL(editingFinished()), this, SLOT(genomeHistorySpinBoxEditingFinished()));
+    connect(ui->genomeHistoryTimeSpinBox, SIGNAL(stepRequested(int)), this, SLOT(genomeHistorySpinBoxStepped(int)));
     connect(ui->customPlot, SIGNAL(mouseMove(QMouseEvent*)), this, SLOT(mouseMoveSignal(QMouseEvent*)));
     connect(ui->customPlot, SIGNAL(mousePress(QMouseEvent*)), this, SLOT(mousePressSignal(QMouseEvent*)));
     connect(ui->customPlot, SIGNAL(mouseRelease(QMouseEvent*)), this, SLOT(mouseReleaseSignal(QMouseEvent*)));
@@ -142,10 +111,140 @@ StatsAndHistoryDialog::StatsAndHistoryDialog(QWidget * parent, const Environment
 
 StatsAndHistoryDialog::~StatsAndHistoryDialog()
 {
+    delete m_logFileMap;
     delete ui;
 }
 
 
+void StatsAndHistoryDialog::setCurrentPopulationLabels()
+{
+    ui->organismCountLabel->setText(this->locale().toString(int(m_environment->getOrganismCount())));
+    ui->environmentWidthLabel->setText(this->locale().toString(int(m_environment->getWidth())));
+    ui->populationDensityLabel->setText(formatDoubleForDisplay(m_environment->getPopulationDensity(), 3, this->locale()));
+
+    ui->seedCountLabel->setText(this->locale().toString(int(m_environment->getSeedCount())));
+    ui->meanSeedsPerPlantLabel->setText(formatDoubleForDisplay(m_environment->getMeanSeedsPerPlant(), 1, this->locale()));
+
+    ui->organismsSproutedLabel->setText(this->locale().toString(g_stats->m_numberOfOrganismsSprouted));
+    ui->organismsStarvedLabel->setText(this->locale().toString(g_stats->m_numberOfOrganismsDiedFromStarvation));
+    ui->organismsDiedFromBadLuckLabel->setText(this->locale().toString(g_stats->m_numberOfOrganismsDiedFromBadLuck));
+    ui->seedsGeneratedLabel->setText(this->locale().toString(g_stats->m_numberOfSeedsGenerated));
+
+    ui->averageGenerationLabel->setText(formatDoubleForDisplay(m_environment->getAverageGeneration(), 1, this->locale()));
+    ui->nucleotideEntropyLabel->setText(formatDoubleForDisplay(m_environment->getMeanNucleotideEntropy(), 3, this->locale()));
+
+    ui->tallestPlantLabel->setText(formatDoubleForDisplay(m_environment->getTallestPlantHeight(), 1, this->locale()));
+    ui->heaviestPlantLabel->setText(formatDoubleForDisplay(m_environment->getHeaviestPlantMass(), 1, this->locale()));
+
+    ui->meanEnergyPerSeedLabel->setText(formatDoubleForDisplay(m_environment->getAverageEnergyPerSeed(), 1, this->locale()));
+
+    int elapsedSeconds = m_environment->getElapsedRealWorldSeconds();
+    int elapsedMinutes = elapsedSeconds / 60;
+    elapsedSeconds %= 60;
+    int elapsedHours = elapsedMinutes / 60;
+    elapsedMinutes %= 60;
+    int elapsedDays = elapsedHours / 24;
+    elapsedHours %= 24;
+    QString elapsedTimeString;
+    if (elapsedDays > 1)
+        elapsedTimeString += QString::number(elapsedDays) + " days, ";
+    if (elapsedDays == 1)
+        elapsedTimeString += QString::number(elapsedDays) + " day, ";
+    if (elapsedHours > 1)
+        elapsedTimeString += QString::number(elapsedHours) + " hours, ";
+    else if (elapsedHours == 1)
+        elapsedTimeString += QString::number(elapsedHours) + " hour, ";
+    if (elapsedMinutes > 0)
+        elapsedTimeString += QString::number(elapsedMinutes) + " min, ";
+    elapsedTimeString += QString::number(elapsedSeconds) + " sec";
+    ui->realWorldTimeLabel->setText(elapsedTimeString);
+}
+
+
+//The slider has one position for each log entry.  As the log merges its older
+//entries, the entry being shown is found again by its time, unless it was the
+//latest, in which case the new latest entry is shown.  The genome and organism
+//are only remade if that gives a different record.
+void StatsAndHistoryDialog::setGenomeHistoryRange()
+{
+    int maxSliderPosition = g_stats->logEntries() - 1;
+    if (maxSliderPosition < 0)
+        return;
+
+    bool showingLatest = ui->genomeHistoryTimeSlider->value() == ui->genomeHistoryTimeSlider->maximum();
+    int shownTime = ui->genomeHistoryTimeSpinBox->value();
+
+    ui->genomeHistoryTimeSlider->blockSignals(true);
+    ui->genomeHistoryTimeSpinBox->setMaximum(int(g_stats->m_log.getTime(maxSliderPosition)));
+    ui->genomeHistoryTimeSlider->setMaximum(maxSliderPosition);
+    if (showingLatest)
+        ui->genomeHistoryTimeSlider->setValue(maxSliderPosition);
+    else
+        ui->genomeHistoryTimeSlider->setValue(g_stats->m_log.getIndexNearestToTime(shownTime));
+    ui->genomeHistoryTimeSlider->blockSignals(false);
+
+    ui->genomeHistoryWidget->setEnabled(maxSliderPosition > 0);
+    ui->genomeHistoryTimeSlider->setEnabled(maxSliderPosition > 0);
+
+    genomeHistoryChanged();
+}
+
+
+//This is called by the main window after each tick while the dialog is open.
+//When there are new log entries, only their points are added to the graphs and
+//only their history records are checked for the organism widget's range, so
+//keeping the dialog open costs little.  If the graph was showing the latest
+//time, its range grows to follow the new points, and once that leaves more
+//than two points per pixel the graph data is remade for the range.  Otherwise
+//the new points are added when the user next moves the range, as all graph
+//data is then remade.
+void StatsAndHistoryDialog::addNewLogEntries()
+{
+    int logEntries = g_stats->logEntries();
+    if (logEntries == 0 || g_stats->m_log.getTime(logEntries - 1) <= m_latestLogTime)
+        return;
+    double previousLatestLogTime = m_latestLogTime;
+    m_latestLogTime = g_stats->m_log.getTime(logEntries - 1);
+
+    if (m_logFileMap != 0)
+        m_logFileMap->refresh();
+
+    int firstNewEntry = logEntries;
+    while (firstNewEntry > 0 && g_stats->m_log.getTime(firstNewEntry - 1) > previousLatestLogTime)
+        --firstNewEntry;
+
+    setCurrentPopulationLabels();
+    setGenomeHistoryRange();
+    extendOrganismWidgetRange(firstNewEntry);
+
+    QCPRange range = ui->customPlot->xAxis->range();
+    if (range.upper < previousLatestLogTime)
+        return;
+
+    for (int i = getFirstSampleAtOrAfter(previousLatestLogTime); i < getSampleCount(); ++i)
+    {
+        double time = getSampleTime(i);
+        if (time <= previousLatestLogTime)
+            continue;
+        for (size_t j = 0; j < m_graphData.size(); ++j)
+        {
+            double value = getSampleValue(m_graphData[j], i);
+            if (value > 0)
+                ui->customPlot->graph(int(j))->addData(time, value);
+        }
+    }
+
+    m_addingNewLogEntries = true;
+    ui->customPlot->xAxis->setRange(range.lower, double(m_environment->getElapsedTime()));
+    m_addingNewLogEntries = false;
+
+    if (!m_graphData.empty() && ui->customPlot->graph(0)->data()->size() > 2 * ui->customPlot->axisRect()->width())
+        setGraphData();
+
+    setGraphYRange();
+}
+
+
 
 void StatsAndHistoryDialog::setGenomeHistoryInfoText()
 {
@@ -167,6 +266,7 @@ void StatsAndHistoryDialog::setGenomeHistoryInfoText()
 void StatsAndHistoryDialog::graphChanged(int newGraphIndex)
 {
     ui->customPlot->clearGraphs();
+    m_graphData.clear();
 
     QPen graphPen;
     graphPen.setWidthF(2.5);
@@ -178,36 +278,31 @@ void StatsAndHistoryDialog::graphChanged(int newGraphIndex)
         graphPen.setColor(Qt::black);
         ui->customPlot->graph(0)->setPen(graphPen);
         ui->customPlot->graph(0)->setName("Height of tallest plant");
-        ui->customPlot->graph(0)->setData(getTimeVector(TALLEST_PLANT),
-                                          getDataVector(TALLEST_PLANT));
+        m_graphData.push_back(TALLEST_PLANT);
 
         ui->customPlot->addGraph();
         graphPen.setColor(Qt::darkRed);
         ui->customPlot->graph(1)->setPen(graphPen);
         ui->customPlot->graph(1)->setName("99th percentile plant height");
-        ui->customPlot->graph(1)->setData(getTimeVector(NINETY_NINTH_PERCENTILE_PLANT_HEIGHT),
-                                          getDataVector(NINETY_NINTH_PERCENTILE_PLANT_HEIGHT));
+        m_graphData.push_back(NINETY_NINTH_PERCENTILE_PLANT_HEIGHT);
 
         ui->customPlot->addGraph();
         graphPen.setColor(Qt::darkGreen);
         ui->customPlot->graph(2)->setPen(graphPen);
         ui->customPlot->graph(2)->setName("95th percentile plant height");
-        ui->customPlot->graph(2)->setData(getTimeVector(NINETY_FIFTH_PERCENTILE_PLANT_HEIGHT),
-                                          getDataVector(NINETY_FIFTH_PERCENTILE_PLANT_HEIGHT));
+        m_graphData.push_back(NINETY_FIFTH_PERCENTILE_PLANT_HEIGHT);
 
         ui->customPlot->addGraph();
         graphPen.setColor(Qt::darkBlue);
         ui->customPlot->graph(3)->setPen(graphPen);
         ui->customPlot->graph(3)->setName("90th percentile plant height");
-        ui->customPlot->graph(3)->setData(getTimeVector(NINETIETH_PERCENTILE_PLANT_HEIGHT),
-                                          getDataVector(NINETIETH_PERCENTILE_PLANT_HEIGHT));
+        m_graphData.push_back(NINETIETH_PERCENTILE_PLANT_HEIGHT);
 
         ui->customPlot->addGraph();
         graphPen.setColor(Qt::darkYellow);
         ui->customPlot->graph(4)->setPen(graphPen);
         ui->customPlot->graph(4)->setName("Median plant height");
-        ui->customPlot->graph(4)->setData(getTimeVector(MEDIAN_PLANT_HEIGHT),
-                                          getDataVector(MEDIAN_PLANT_HEIGHT));
+        m_graphData.push_back(MEDIAN_PLANT_HEIGHT);
 
         turnOnLegend();
         ui->customPlot->yAxis->setLabel("height");
@@ -218,36 +313,31 @@ void StatsAndHistoryDialog::graphChanged(int newGraphIndex)
         graphPen.setColor(Qt::black);
         ui->customPlot->graph(0)->setPen(graphPen);
         ui->customPlot->graph(0)->setName("Mass of heaviest plant");
-        ui->customPlot->graph(0)->setData(getTimeVector(HEAVIEST_PLANT),
-                                          getDataVector(HEAVIEST_PLANT));
+        m_graphData.push_back(HEAVIEST_PLANT);
 
         ui->customPlot->addGraph();
         graphPen.setColor(Qt::darkRed);
         ui->customPlot->graph(1)->setPen(graphPen);
         ui->customPlot->graph(1)->setName("99th percentile plant mass");
-        ui->customPlot->graph(1)->setData(getTimeVector(NINETY_NINTH_PERCENTILE_PLANT_MASS),
-                                          getDataVector(NINETY_NINTH_PERCENTILE_PLANT_MASS));
+        m_graphData.push_back(NINETY_NINTH_PERCENTILE_PLANT_MASS);
 
         ui->customPlot->addGraph();
         graphPen.setColor(Qt::darkGreen);
         ui->customPlot->graph(2)->setPen(graphPen);
         ui->customPlot->graph(2)->setName("95th percentile plant mass");
-        ui->customPlot->graph(2)->setData(getTimeVector(NINETY_FIFTH_PERCENTILE_PLANT_MASS),
-                                          getDataVector(NINETY_FIFTH_PERCENTILE_PLANT_MASS));
+        m_graphData.push_back(NINETY_FIFTH_PERCENTILE_PLANT_MASS);
 
         ui->customPlot->addGraph();
         graphPen.setColor(Qt::darkBlue);
         ui->customPlot->graph(3)->setPen(graphPen);
         ui->customPlot->graph(3)->setName("90th percentile plant mass");
-        ui->customPlot->graph(3)->setData(getTimeVector(NINETIETH_PERCENTILE_PLANT_MASS),
-                                          getDataVector(NINETIETH_PERCENTILE_PLANT_MASS));
+        m_graphData.push_back(NINETIETH_PERCENTILE_PLANT_MASS);
 
         ui->customPlot->addGraph();
         graphPen.setColor(Qt::darkYellow);
         ui->customPlot->graph(4)->setPen(graphPen);
         ui->customPlot->graph(4)->setName("Median plant mass");
-        ui->customPlot->graph(4)->setData(getTimeVector(MEDIAN_PLANT_MASS),
-                                          getDataVector(MEDIAN_PLANT_MASS));
+        m_graphData.push_back(MEDIAN_PLANT_MASS);
 
         turnOnLegend();
         ui->customPlot->yAxis->setLabel("mass");
@@ -258,36 +348,31 @@ void StatsAndHistoryDialog::graphChanged(int newGraphIndex)
         graphPen.setColor(Qt::black);
         ui->customPlot->graph(0)->setPen(graphPen);
         ui->customPlot->graph(0)->setName("Most plant energy");
-        ui->customPlot->graph(0)->setData(getTimeVector(MOST_PLANT_ENERGY),
-                                          getDataVector(MOST_PLANT_ENERGY));
+        m_graphData.push_back(MOST_PLANT_ENERGY);
 
         ui->customPlot->addGraph();
         graphPen.setColor(Qt::darkRed);
         ui->customPlot->graph(1)->setPen(graphPen);
         ui->customPlot->graph(1)->setName("99th percentile plant energy");
-        ui->customPlot->graph(1)->setData(getTimeVector(NINETY_NINTH_PERCENTILE_PLANT_ENERGY),
-                                          getDataVector(NINETY_NINTH_PERCENTILE_PLANT_ENERGY));
+        m_graphData.push_back(NINETY_NINTH_PERCENTILE_PLANT_ENERGY);
 
         ui->customPlot->addGraph();
         graphPen.setColor(Qt::darkGreen);
         ui->customPlot->graph(2)->setPen(graphPen);
         ui->customPlot->graph(2)->setName("95th percentile plant energy");
-        ui->customPlot->graph(2)->setData(getTimeVector(NINETY_FIFTH_PERCENTILE_PLANT_ENERGY),
-                                          getDataVector(NINETY_FIFTH_PERCENTILE_PLANT_ENERGY));
+        m_graphData.push_back(NINETY_FIFTH_PERCENTILE_PLANT_ENERGY);
 
         ui->customPlot->addGraph();
         graphPen.setColor(Qt::darkBlue);
         ui->customPlot->graph(3)->setPen(graphPen);
         ui->customPlot->graph(3)->setName("90th percentile plant energy");
-        ui->customPlot->graph(3)->setData(getTimeVector(NINETIETH_PERCENTILE_PLANT_ENERGY),
-                                          getDataVector(NINETIETH_PERCENTILE_PLANT_ENERGY));
+        m_graphData.push_back(NINETIETH_PERCENTILE_PLANT_ENERGY);
 
         ui->customPlot->addGraph();
         graphPen.setColor(Qt::darkYellow);
         ui->customPlot->graph(4)->setPen(graphPen);
         ui->customPlot->graph(4)->setName("Median plant energy");
-        ui->customPlot->graph(4)->setData(getTimeVector(MEDIAN_PLANT_ENERGY),
-                                          getDataVector(MEDIAN_PLANT_ENERGY));
+        m_graphData.push_back(MEDIAN_PLANT_ENERGY);
 
         turnOnLegend();
         ui->customPlot->yAxis->setLabel("energy");
@@ -297,8 +382,7 @@ void StatsAndHistoryDialog::graphChanged(int newGraphIndex)
         ui->customPlot->addGraph();
         graphPen.setColor(Qt::darkRed);
         ui->customPlot->graph(0)->setPen(graphPen);
-        ui->customPlot->graph(0)->setData(getTimeVector(POPULATION),
-                                          getDataVector(POPULATION));
+        m_graphData.push_back(POPULATION);
 
         ui->customPlot->yAxis->setLabel("population density");
         ui->customPlot->legend->setVisible(false);
@@ -308,8 +392,7 @@ void StatsAndHistoryDialog::graphChanged(int newGraphIndex)
         ui->customPlot->addGraph();
         graphPen.setColor(Qt::darkRed);
         ui->customPlot->graph(0)->setPen(graphPen);
-        ui->customPlot->graph(0)->setData(getTimeVector(SEED_COUNT),
-                                          getDataVector(SEED_COUNT));
+        m_graphData.push_back(SEED_COUNT);
 
         ui->customPlot->legend->setVisible(false);
         ui->customPlot->yAxis->setLabel("seeds");
@@ -319,17 +402,32 @@ void StatsAndHistoryDialog::graphChanged(int newGraphIndex)
         ui->customPlot->addGraph();
         graphPen.setColor(Qt::darkRed);
         ui->customPlot->graph(0)->setPen(graphPen);
-        ui->customPlot->graph(0)->setData(getTimeVector(ENERGY_PER_SEED),
-                                          getDataVector(ENERGY_PER_SEED));
+        m_graphData.push_back(ENERGY_PER_SEED);
 
         ui->customPlot->legend->setVisible(false);
         ui->customPlot->yAxis->setLabel("energy");
         break;
     }
 
+    setGraphData();
     setGraphYRange();
 }
 
+
+//The graphs only hold points for the visible time range, at most two per pixel,
+//so this is called again whenever the range changes.
+void StatsAndHistoryDialog::setGraphData()
+{
+    QCPRange range = ui->customPlot->xAxis->range();
+    int buckets = std::max(1, ui->customPlot->axisRect()->width());
+    for (size_t i = 0; i < m_graphData.size(); ++i)
+    {
+        QVector<double> times, values;
+        getDecimatedData(m_graphData[i], range.lower, range.upper, buckets, &times, &values);
+        ui->customPlot->graph(int(i))->setData(times, values);
+    }
+}
+
 void StatsAndHistoryDialog::turnOnLegend()
 {
     // set the placement of the legend (index 0 in the axis rect's inset layout) to not be
@@ -420,6 +518,11 @@ void StatsAndHistoryDialog::xRangeChanged(const QCPRange &newRange, const QCPRan
         ui->customPlot->xAxis->setRange(0.0, currentSpan);
     else if (newRange.upper > elapsedTime)
         ui->customPlot->xAxis->setRange(double(elapsedTime) - currentSpan, double(elapsedTime));
+
+    //If the range was corrected above, the graph data was set for the corrected
+    //range when it changed.  New log entries add their own points.
+    else if (!m_addingNewLogEntries)
+        setGraphData();
 }
 
 
@@ -471,7 +574,7 @@ void StatsAndHistoryDialog::setLogScale(bool logScale)
 
 void StatsAndHistoryDialog::outputHistoryInfoButtonPressed()
 {
-    if (g_stats->m_time.size() == 0)
+    if (g_stats->logEntries() == 0)
     {
         QMessageBox::information(this, "No data to output", "There is no data to output to file.\n\n"
                                                             "Run the simulation for a while to generate\n"
@@ -490,7 +593,7 @@ void StatsAndHistoryDialog::outputHistoryInfoButtonPressed()
 
             QTextStream stream(&saveFile);
             stream << makeHistoryInfoCSVHeaderLine() << endl;
-            int timeCount = int(g_stats->m_time.size());
+            int timeCount = g_stats->logEntries();
             for (int i = 0; i < timeCount; ++i)
                 stream << makeHistoryInfoCSVBodyLine(i) << endl;
         }
@@ -531,27 +634,16 @@ QString StatsAndHistoryDialog::makeHistoryInfoCSVHeaderLine()
 QString StatsAndHistoryDialog::makeHistoryInfoCSVBodyLine(int i)
 {
     QString body;
-    body += QString::number(g_stats->m_time[i]) + ",";
-    body += QString::number(g_stats->m_populationDensity[i]) + ",";
-    body += QString::number(g_stats->m_tallestPlantHeight[i]) + ",";
-    body += QString::number(g_stats->m_99thPercentilePlantHeight[i]) + ",";
-    body += QString::number(g_stats->m_95thPercentilePlantHeight[i]) + ",";
-    body += QString::number(g_stats->m_90thPercentilePlantHeight[i]) + ",";
-    body += QString::number(g_stats->m_medianPlantHeight[i]) + ",";
-    body += QString::number(g_stats->m_heaviestPlantMass[i]) + ",";
-    body += QString::number(g_stats->m_99thPercentilePlantMass[i]) + ",";
-    body += QString::number(g_stats->m_95thPercentilePlantMass[i]) + ",";
-    body += QString::number(g_stats->m_90thPercentilePlantMass[i]) + ",";
-    body += QString::number(g_stats->m_medianPlantMass[i]) + ",";
-    body += QString::number(g_stats->m_mostPlantEnergy[i]) + ",";
-    body += QString::number(g_stats->m_99thPercentilePlantEnergy[i]) + ",";
-    body += QString::number(g_stats->m_95thPercentilePlantEnergy[i]) + ",";
-    body += QString::number(g_stats->m_90thPercentilePlantEnergy[i]) + ",";
-    body += QString::number(g_stats->m_medianPlantEnergy[i]) + ",";
-    body += QString::number(g_stats->m_meanSeedsPerPlant[i]) + ",";
-    body += QString::number(g_stats->m_meanEnergyPerSeed[i]) + ",";
-    body += g_stats->m_averageGenomeOrganism[i]->getGenome()->outputAsString() + ",";
-    body += g_stats->m_randomGenomeOrganism[i]->getGenome()->outputAsString();
+    body += QString::number(g_stats->m_log.getTime(i)) + ",";
+    for (int stat = 0; stat < LOGGED_STAT_COUNT; ++stat)
+        body += QString::number(g_stats->m_log.getMean(GraphData(stat), i)) + ",";
+    const HistoryRecord & averageGenome = g_stats->getHistoryRecord(AVERAGE_GENOME, i);
+    const HistoryRecord & randomGenome = g_stats->getHistoryRecord(RANDOM_ORGANISM, i);
+    if (!averageGenome.isEmpty())
+        body += averageGenome.m_genome->outputAsString();
+    body += ",";
+    if (!randomGenome.isEmpty())
+        body += randomGenome.m_genome->outputAsString();
     return body;
 }
 
@@ -585,183 +677,203 @@ void StatsAndHistoryDialog::outputCurrentInfoButtonPressed()
 }
 
 
-QVector<double> StatsAndHistoryDialog::getDataVector(GraphData graphData)
+//The graphs are drawn from the log file if there is one, as it has every
+//sample.  Otherwise they are drawn from the in-memory log, where each older
+//point is the mean over the time its entry covers.
+int StatsAndHistoryDialog::getSampleCount() const
 {
-    std::vector<double> * statVector;
-    switch (graphData)
-    {
-    case POPULATION:
-        statVector = &(g_stats->m_populationDensity);
-        break;
-
-    case TALLEST_PLANT:
-        statVector = &(g_stats->m_tallestPlantHeight);
-        break;
-    case NINETY_NINTH_PERCENTILE_PLANT_HEIGHT:
-        statVector = &(g_stats->m_99thPercentilePlantHeight);
-        break;
-    case NINETY_FIFTH_PERCENTILE_PLANT_HEIGHT:
-        statVector = &(g_stats->m_95thPercentilePlantHeight);
-        break;
-    case NINETIETH_PERCENTILE_PLANT_HEIGHT:
-        statVector = &(g_stats->m_90thPercentilePlantHeight);
-        break;
-    case MEDIAN_PLANT_HEIGHT:
-        statVector = &(g_stats->m_medianPlantHeight);
-        break;
-
-    case HEAVIEST_PLANT:
-        statVector = &(g_stats->m_heaviestPlantMass);
-        break;
-    case NINETY_NINTH_PERCENTILE_PLANT_MASS:
-        statVector = &(g_stats->m_99thPercentilePlantMass);
-        break;
-    case NINETY_FIFTH_PERCENTILE_PLANT_MASS:
-        statVector = &(g_stats->m_95thPercentilePlantMass);
-        break;
-    case NINETIETH_PERCENTILE_PLANT_MASS:
-        statVector = &(g_stats->m_90thPercentilePlantMass);
-        break;
-    case MEDIAN_PLANT_MASS:
-        statVector = &(g_stats->m_medianPlantMass);
-        break;
-
-    case MOST_PLANT_ENERGY:
-        statVector = &(g_stats->m_mostPlantEnergy);
-        break;
-    case NINETY_NINTH_PERCENTILE_PLANT_ENERGY:
-        statVector = &(g_stats->m_99thPercentilePlantEnergy);
-        break;
-    case NINETY_FIFTH_PERCENTILE_PLANT_ENERGY:
-        statVector = &(g_stats->m_95thPercentilePlantEnergy);
-        break;
-    case NINETIETH_PERCENTILE_PLANT_ENERGY:
-        statVector = &(g_stats->m_90thPercentilePlantEnergy);
-        break;
-    case MEDIAN_PLANT_ENERGY:
-        statVector = &(g_stats->m_medianPlantEnergy);
-        break;
+    if (m_logFileMap != 0)
+        return m_logFileMap->size();
+    return g_stats->logEntries();
+}
+double StatsAndHistoryDialog::getSampleTime(int index) const
+{
+    if (m_logFileMap != 0)
+        return m_logFileMap->getTime(index);
+    return g_stats->m_log.getTime(index);
+}
+double StatsAndHistoryDialog::getSampleValue(GraphData graphData, int index) const
+{
+    if (m_logFileMap != 0)
+        return m_logFileMap->getValue(graphData, index);
+    return g_stats->m_log.getMean(graphData, index);
+}
 
-    case SEED_COUNT:
-        statVector = &(g_stats->m_meanSeedsPerPlant);
-        break;
-    case ENERGY_PER_SEED:
-        statVector = &(g_stats->m_meanEnergyPerSeed);
-        break;
+//An in-memory log entry that has been merged covers several samples, so its
+//lowest and highest are the extremes of those samples.  A sample from the log
+//file is a single value.
+double StatsAndHistoryDialog::getSampleLow(GraphData graphData, int index) const
+{
+    if (m_logFileMap != 0)
+        return m_logFileMap->getValue(graphData, index);
+    return g_stats->m_log.getMin(graphData, index);
+}
+double StatsAndHistoryDialog::getSampleHigh(GraphData graphData, int index) const
+{
+    if (m_logFileMap != 0)
+        return m_logFileMap->getValue(graphData, index);
+    return g_stats->m_log.getMax(graphData, index);
+}
 
-    default:
-        return QVector<double>();
-    }
 
-    QVector<double> returnVector;
-    for (size_t i = 0; i < statVector->size(); ++i)
+//Sample times only increase, so this is a binary search.  It returns the sample
+//count if every sample is before the time.
+int StatsAndHistoryDialog::getFirstSampleAtOrAfter(double time) const
+{
+    int low = 0;
+    int high = getSampleCount();
+    while (low < high)
     {
-        if ((*statVector)[i] > 0)
-            returnVector.push_back((*statVector)[i]);
+        int middle = (low + high) / 2;
+        if (getSampleTime(middle) < time)
+            low = middle + 1;
+        else
+            high = middle;
     }
-
-    return returnVector;
+    return low;
 }
 
 
-QVector<double> StatsAndHistoryDialog::getTimeVector(GraphData graphData)
+//This makes the points for one graph over the given time range.  When there are
+//more samples than pixels, the samples in each pixel-wide bucket are reduced to
+//the lowest and highest, so spikes are still drawn but the number of points is
+//bounded by the plot width.  For merged log entries, these are the entries'
+//own lowest and highest rather than their means.  One sample past each end of
+//the range is included so the line runs to the edges.  Only positive values
+//are used, so the graphs work with a log scale.
+void StatsAndHistoryDialog::getDecimatedData(GraphData graphData, double lower, double upper, int buckets,
+                                             QVector<double> * times, QVector<double> * values) const
 {
-    std::vector<double> * statVector;
-    switch (graphData)
-    {
-    case POPULATION:
-        statVector = &(g_stats->m_populationDensity);
-        break;
-
-    case TALLEST_PLANT:
-        statVector = &(g_stats->m_tallestPlantHeight);
-        break;
-    case NINETY_NINTH_PERCENTILE_PLANT_HEIGHT:
-        statVector = &(g_stats->m_99thPercentilePlantHeight);
-        break;
-    case NINETY_FIFTH_PERCENTILE_PLANT_HEIGHT:
-        statVector = &(g_stats->m_95thPercentilePlantHeight);
-        break;
-    case NINETIETH_PERCENTILE_PLANT_HEIGHT:
-        statVector = &(g_stats->m_90thPercentilePlantHeight);
-        break;
-    case MEDIAN_PLANT_HEIGHT:
-        statVector = &(g_stats->m_medianPlantHeight);
-        break;
-
-    case HEAVIEST_PLANT:
-        statVector = &(g_stats->m_heaviestPlantMass);
-        break;
-    case NINETY_NINTH_PERCENTILE_PLANT_MASS:
-        statVector = &(g_stats->m_99thPercentilePlantMass);
-        break;
-    case NINETY_FIFTH_PERCENTILE_PLANT_MASS:
-        statVector = &(g_stats->m_95thPercentilePlantMass);
-        break;
-    case NINETIETH_PERCENTILE_PLANT_MASS:
-        statVector = &(g_stats->m_90thPercentilePlantMass);
-        break;
-    case MEDIAN_PLANT_MASS:
-        statVector = &(g_stats->m_medianPlantMass);
-        break;
-
-    case MOST_PLANT_ENERGY:
-        statVector = &(g_stats->m_mostPlantEnergy);
-        break;
-    case NINETY_NINTH_PERCENTILE_PLANT_ENERGY:
-        statVector = &(g_stats->m_99thPercentilePlantEnergy);
-        break;
-    case NINETY_FIFTH_PERCENTILE_PLANT_ENERGY:
-        statVector = &(g_stats->m_95thPercentilePlantEnergy);
-        break;
-    case NINETIETH_PERCENTILE_PLANT_ENERGY:
-        statVector = &(g_stats->m_90thPercentilePlantEnergy);
-        break;
-    case MEDIAN_PLANT_ENERGY:
-        statVector = &(g_stats->m_medianPlantEnergy);
-        break;
+    if (graphData < 0 || graphData >= LOGGED_STAT_COUNT)
+        return;
 
-    case SEED_COUNT:
-        statVector = &(g_stats->m_meanSeedsPerPlant);
-        break;
-    case ENERGY_PER_SEED:
-        statVector = &(g_stats->m_meanEnergyPerSeed);
-        break;
+    int first = std::max(0, getFirstSampleAtOrAfter(lower) - 1);
+    int last = std::min(getSampleCount() - 1, getFirstSampleAtOrAfter(upper));
+    double bucketWidth = (upper - lower) / buckets;
 
-    default:
-        return QVector<double>();
+    if (last - first + 1 <= 2 * buckets || bucketWidth <= 0.0)
+    {
+        for (int i = first; i <= last; ++i)
+        {
+            double value = getSampleValue(graphData, i);
+            if (value > 0)
+            {
+                times->push_back(getSampleTime(i));
+                values->push_back(value);
+            }
+        }
+        return;
     }
 
-    QVector<double> returnVector;
-    for (size_t i = 0; i < statVector->size(); ++i)
+    int i = first;
+    while (i <= last)
     {
-        if ((*statVector)[i] > 0)
-            returnVector.push_back(g_stats->m_time[i]);
-    }
+        double bucket = floor((getSampleTime(i) - lower) / bucketWidth);
+        int lowIndex = -1, highIndex = -1;
+        double low = 0.0, high = 0.0;
+        for (; i <= last && floor((getSampleTime(i) - lower) / bucketWidth) == bucket; ++i)
+        {
+            double sampleLow = getSampleLow(graphData, i);
+            double sampleHigh = getSampleHigh(graphData, i);
+            if (sampleLow > 0 && (lowIndex == -1 || sampleLow < low))
+            {
+                lowIndex = i;
+                low = sampleLow;
+            }
+            if (sampleHigh > 0 && (highIndex == -1 || sampleHigh > high))
+            {
+                highIndex = i;
+                high = sampleHigh;
+            }
+        }
+        if (lowIndex == -1 && highIndex == -1)
+            continue;
+        if (lowIndex == -1)
+        {
+            lowIndex = highIndex;
+            low = high;
+        }
+        if (highIndex == -1)
+        {
+            highIndex = lowIndex;
+            high = low;
+        }
 
-    return returnVector;
+        int earlier = std::min(lowIndex, highIndex);
+        int later = std::max(lowIndex, highIndex);
+        double earlierValue = (earlier == lowIndex) ? low : high;
+        double laterValue = (earlier == lowIndex) ? high : low;
+        times->push_back(getSampleTime(earlier));
+        values->push_back(earlierValue);
+        if (later != earlier || laterValue != earlierValue)
+        {
+            times->push_back(getSampleTime(later));
+            values->push_back(laterValue);
+        }
+    }
 }
 
 
 
 
-void StatsAndHistoryDialog::setOrganismWidgetRange()
+HistoryOrganismType StatsAndHistoryDialog::getHistoryOrganismType() const
 {
-    double heightExtent, rightExtent, leftExtent;
-
-    HistoryOrganismType historyOrganismType;
     if (ui->historyTypeComboBox->currentIndex() == 0)
-        historyOrganismType = AVERAGE_GENOME;
+        return AVERAGE_GENOME;
     else
-        historyOrganismType = RANDOM_ORGANISM;
+        return RANDOM_ORGANISM;
+}
+
+
+//This finds the organism widget's range from the whole history.  It is only
+//needed when the dialog opens or the history type changes, as new log entries
+//are added to the range by extendOrganismWidgetRange.
+void StatsAndHistoryDialog::setOrganismWidgetRange()
+{
+    HistoryOrganismType historyOrganismType = getHistoryOrganismType();
+    m_historyHeightExtent = g_stats->getHistoryOrganismHeightExtent(historyOrganismType);
+    m_historyLeftExtent = g_stats->getHistoryOrganismLeftExtent(historyOrganismType);
+    m_historyRightExtent = g_stats->getHistoryOrganismRightExtent(historyOrganismType);
+    applyOrganismWidgetRange();
+}
 
-    heightExtent = g_stats->getHistoryOrganismHeightExtent(historyOrganismType);
-    leftExtent = g_stats->getHistoryOrganismLeftExtent(historyOrganismType);
-    rightExtent = g_stats->getHistoryOrganismRightExtent(historyOrganismType);
+//The range only grows here.  Records dropped when the log merges its entries
+//may have been the largest, but keeping their range is harmless and stops the
+//organism widget from changing scale as the simulation runs.
+void StatsAndHistoryDialog::extendOrganismWidgetRange(int firstNewEntry)
+{
+    HistoryOrganismType historyOrganismType = getHistoryOrganismType();
+    bool changed = false;
+    for (int i = firstNewEntry; i < g_stats->logEntries(); ++i)
+    {
+        const HistoryRecord & record = g_stats->getHistoryRecord(historyOrganismType, i);
+        if (record.isEmpty())
+            continue;
+        if (record.m_highestDrawnPoint > m_historyHeightExtent)
+        {
+            m_historyHeightExtent = record.m_highestDrawnPoint;
+            changed = true;
+        }
+        if (record.m_leftmostDrawnPoint < m_historyLeftExtent)
+        {
+            m_historyLeftExtent = record.m_leftmostDrawnPoint;
+            changed = true;
+        }
+        if (record.m_rightmostDrawnPoint > m_historyRightExtent)
+        {
+            m_historyRightExtent = record.m_rightmostDrawnPoint;
+            changed = true;
+        }
+    }
+    if (changed)
+        applyOrganismWidgetRange();
+}
 
-    double sideExtent = std::max(rightExtent, -1.0 * leftExtent);
+void StatsAndHistoryDialog::applyOrganismWidgetRange()
+{
+    double sideExtent = std::max(m_historyRightExtent, -1.0 * m_historyLeftExtent);
 
-    ui->historyOrganismWidget->setHeightExtent(heightExtent);
+    ui->historyOrganismWidget->setHeightExtent(m_historyHeightExtent);
     ui->historyOrganismWidget->setLeftExtent(-1.0 * sideExtent);
     ui->historyOrganismWidget->setRightExtent(sideExtent);
 }
@@ -770,21 +882,29 @@ void StatsAndHistoryDialog::setOrganismWidgetRange()
 
 void StatsAndHistoryDialog::genomeHistoryChanged()
 {
+    if (g_stats->logEntries() == 0)
+        return;
+
     int position = ui->genomeHistoryTimeSlider->value();
 
-    ui->genomeHistoryTimeSpinBox->setValue(position * m_sizeOfEachTick);
+    ui->genomeHistoryTimeSpinBox->setValue(int(g_stats->m_log.getTime(position)));
 
-    Organism * historyOrganism;
-    if (ui->historyTypeComboBox->currentIndex() == 0)
-        historyOrganism = g_stats->m_averageGenomeOrganism[position];
-    else
-        historyOrganism = g_stats->m_randomGenomeOrganism[position];
+    //Growing the organism and writing out the genome are the slow parts, so
+    //they are skipped if the record is the one already shown.
+    HistoryOrganismType historyOrganismType = getHistoryOrganismType();
+    const HistoryRecord & historyRecord = g_stats->getHistoryRecord(historyOrganismType, position);
+    if (int(historyOrganismType) == m_shownHistoryType && historyRecord.m_genome == m_shownGenome)
+        return;
+    m_shownHistoryType = int(historyOrganismType);
+    m_shownGenome = historyRecord.m_genome;
 
-    if (historyOrganism != 0)
-        ui->historyGenomeTextEdit->setText(historyOrganism->getGenome()->outputAsString());
+    if (!historyRecord.isEmpty())
+        ui->historyGenomeTextEdit->setText(historyRecord.m_genome->outputAsString());
     else
         ui->historyGenomeTextEdit->setText("");
 
+    const Organism * historyOrganism = g_stats->getHistoryOrganism(historyOrganismType, position);
+
     ui->historyOrganismWidget->setOrganism(historyOrganism);
     ui->historyOrganismWidget->update();
 }
@@ -794,31 +914,33 @@ void StatsAndHistoryDialog::genomeHistoryChanged()
 void StatsAndHistoryDialog::genomeHistorySpinBoxChanged()
 {
     int value = ui->genomeHistoryTimeSpinBox->value();
-    int roundedValue = roundHistoryValue(value);
+    int position = g_stats->m_log.getIndexNearestToTime(value);
 
-    //If the value changed when rounded, don't do anything now,
-    //as that means the user is typing a value in and we don't
-    //we'll handle stuff when the editing is finished.
-    if (value != roundedValue)
+    //If the value isn't the time of a log entry, don't do anything now,
+    //as that means the user is typing a value in and we'll handle
+    //stuff when the editing is finished.
+    if (position < 0 || int(g_stats->m_log.getTime(position)) != value)
         return;
 
-    ui->genomeHistoryTimeSpinBox->setValue(roundedValue);
-    ui->genomeHistoryTimeSlider->setValue(roundedValue / m_sizeOfEachTick);
+    ui->genomeHistoryTimeSlider->setValue(position);
 }
 
+//Log entries aren't evenly spaced in time, as older entries have been merged,
+//so the value is moved to the time of the nearest entry.
 void StatsAndHistoryDialog::genomeHistorySpinBoxEditingFinished()
 {
-    int roundedValue = roundHistoryValue(ui->genomeHistoryTimeSpinBox->value());
-    ui->genomeHistoryTimeSpinBox->setValue(roundedValue);
-    ui->genomeHistoryTimeSlider->setValue(roundedValue / m_sizeOfEachTick);
+    int position = g_stats->m_log.getIndexNearestToTime(ui->genomeHistoryTimeSpinBox->value());
+    if (position < 0)
+        return;
+    ui->genomeHistoryTimeSpinBox->setValue(int(g_stats->m_log.getTime(position)));
+    ui->genomeHistoryTimeSlider->setValue(position);
 }
 
-
-int StatsAndHistoryDialog::roundHistoryValue(int valueToRound)
+//The slider position is the log entry, so stepping moves it one entry per
+//step and the spin box follows.
+void StatsAndHistoryDialog::genomeHistorySpinBoxStepped(int steps)
 {
-    double ticks = double(valueToRound) / m_sizeOfEachTick;
-    int roundedTicks = int(ticks + 0.5);
-    return roundedTicks * m_sizeOfEachTick;
+    ui->genomeHistoryTimeSlider->setValue(ui->genomeHistoryTimeSlider->value() + steps);
 }
 
 
@@ -25,8 +25,11 @@
 #include <QCheckBox>
 #include "qcustomplot.h"
 #include "../program/globals.h"
+#include "boost/shared_ptr.hpp"
 
 class Environment;
+class StatsLogFileMap;
+class Genome;
 
 namespace Ui {
 class StatsAndHistoryDialog;
@@ -48,11 +51,20 @@ public:
     void setDisplayedGraph(int graphIndex);
     void setHistoryType(int historyType);
     void setLogScale(bool logScale);
+    void addNewLogEntries();
 
 private:
     Ui::StatsAndHistoryDialog * ui;
     const Environment * m_environment;
-    int m_sizeOfEachTick;
+    StatsLogFileMap * m_logFileMap;
+    std::vector<GraphData> m_graphData; //The stat shown by each graph, in graph order
+    bool m_addingNewLogEntries;
+    double m_latestLogTime; //The time of the newest log entry the dialog has shown
+    int m_shownHistoryType; //The history type and genome on display, or -1 if none
+    boost::shared_ptr<Genome> m_shownGenome;
+    double m_historyHeightExtent;
+    double m_historyLeftExtent;
+    double m_historyRightExtent;
     bool m_draggingLegend;
     QPointF m_dragLegendOrigin;
 
@@ -60,10 +72,21 @@ private:
     void setGraphYRange();
     QString makeHistoryInfoCSVHeaderLine();
     QString makeHistoryInfoCSVBodyLine(int index);
-    QVector<double> getDataVector(GraphData graphData);
-    QVector<double> getTimeVector(GraphData graphData);
+    void setGraphData();
+    void setCurrentPopulationLabels();
+    void setGenomeHistoryRange();
+    HistoryOrganismType getHistoryOrganismType() const;
+    void extendOrganismWidgetRange(int firstNewEntry);
+    void applyOrganismWidgetRange();
+    int getSampleCount() const;
+    double getSampleTime(int index) const;
+    double getSampleValue(GraphData graphData, int index) const;
+    double getSampleLow(GraphData graphData, int index) const;
+    double getSampleHigh(GraphData graphData, int index) const;
+    int getFirstSampleAtOrAfter(double time) const;
+    void getDecimatedData(GraphData graphData, double lower, double upper, int buckets,
+                          QVector<double> * times, QVector<double> * values) const;
     QString getYAxisLabel(GraphData graphData);
-    int roundHistoryValue(int valueToRound);
     void turnOnLegend();
 
 private slots:
@@ -76,6 +99,7 @@ private slots:
     void setOrganismWidgetRange();
     void genomeHistorySpinBoxChanged();
     void genomeHistorySpinBoxEditingFinished();
+    void genomeHistorySpinBoxStepped(int steps);
     void mouseMoveSignal(QMouseEvent *event);
     void mousePressSignal(QMouseEvent *event);
     void mouseReleaseSignal(QMouseEvent *event);